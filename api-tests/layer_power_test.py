@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Checks that an overlay added after the last one was removed is composed over
+the current frame, also when the power limiter has to dim that refresh.
+
+  1. frame A (blue) is shown, overlay added and removed again
+  2. frame B (black) is shown, there are no layers
+  3. a white overlay covering all but the last column is added, which puts
+     the strip over hw.led.ins[0].maxpwr and engages the limiter
+  4. /api/framebuffer must show the overlay and frame B in the last column
+     (a stale compositor output shows frame A there), and the "power.limited"
+     counter in /api/stats must have gone up
+
+Run it while no chain, text or effect is playing, they would paint over the
+frames. maxpwr has to be low enough for a mostly white matrix to exceed it.
+
+  python3 layer_power_test.py --esp-ip 192.168.1.42
+"""
+import argparse
+import base64
+import os
+import struct
+import sys
+import time
+
+import requests
+
+LAYER_ID = 9
+LAYER_FILE = "layer_power_test.bmp"
+FRAME_A = (0, 0, 255)
+FRAME_B = (0, 0, 0)
+WHITE = (255, 255, 255)
+
+
+def solid_bmp(width, height, rgb):
+    row = (width * 3 + 3) & ~3
+    line = bytes((rgb[2], rgb[1], rgb[0])) * width + bytes(row - width * 3)
+    pixels = line * height
+    header = b"BM" + struct.pack("<IHHI", 54 + len(pixels), 0, 0, 54)
+    info = struct.pack("<IiiHHIIiiII", 40, width, height, 1, 24, 0, len(pixels), 2835, 2835, 0, 0)
+    return header + info + pixels
+
+
+def show_frame(base, width, height, rgb):
+    """Whole matrix through /api/region"""
+    body = struct.pack("<hhHH", 0, 0, width, height) + bytes(rgb) * (width * height)
+    requests.post(f"{base}/api/region", data=body, timeout=10).raise_for_status()
+
+
+def add_layer(base, width, height):
+    r = requests.post(f"{base}/api/layer", json={"id": LAYER_ID, "file": LAYER_FILE, "x": 0, "y": 0,
+                                                "w": width - 1, "h": height}, timeout=10)
+    r.raise_for_status()
+
+
+def remove_layer(base):
+    requests.delete(f"{base}/api/layer?id={LAYER_ID}", timeout=10).raise_for_status()
+
+
+def power(base):
+    return requests.get(f"{base}/api/stats", timeout=5).json().get("power", {})
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Overlay re-added after removal, with the power limiter engaged")
+    parser.add_argument("--esp-ip", default=os.environ.get("ESP_IP", "192.168.1.123"), help="device address (or $ESP_IP)")
+    parser.add_argument("--settle-ms", type=int, default=300, help="time loop() gets to push a change out")
+    args = parser.parse_args()
+    base = f"http://{args.esp_ip}"
+    settle = args.settle_ms / 1000
+
+    spec = requests.get(f"{base}/api/imgspec", timeout=5).json()
+    width, height = spec["width"], spec["height"]
+    if not power(base).get("budgetMa"):
+        print("FAIL: no power budget, set hw.led.ins[0].maxpwr in config.json")
+        return 2
+
+    img = base64.b64encode(solid_bmp(width - 1, height, WHITE)).decode()
+    requests.post(f"{base}/api/img", json={"file": LAYER_FILE, "img": img}, timeout=30).raise_for_status()
+
+    show_frame(base, width, height, FRAME_A)
+    add_layer(base, width, height)
+    time.sleep(settle)
+    remove_layer(base)
+    time.sleep(settle)
+    show_frame(base, width, height, FRAME_B)
+    time.sleep(settle)
+    limited = power(base).get("limited", 0)
+
+    add_layer(base, width, height)
+    time.sleep(settle)
+    pw = power(base)
+    r = requests.get(f"{base}/api/framebuffer?format=raw", timeout=10)
+    r.raise_for_status()
+    fb = r.content
+    remove_layer(base)
+
+    ok = True
+    if pw.get("limited", 0) <= limited:
+        print(f"FAIL: limiter not engaged ({pw.get('estimatedMa')} mA of {pw.get('budgetMa')} mA), lower maxpwr")
+        ok = False
+    stale = wrong = 0
+    for y in range(height):
+        for x in range(width):
+            o = (y * width + x) * 3
+            px = tuple(fb[o:o + 3])
+            want = WHITE if x < width - 1 else FRAME_B
+            if px != want:
+                wrong += 1
+                stale += px == FRAME_A
+    if wrong:
+        print(f"FAIL: {wrong} pixels differ from the expected frame, {stale} of them still show frame A")
+        ok = False
+    print(f"limit {pw.get('limit')} %, limited {limited} -> {pw.get('limited')}")
+    print("PASS" if ok else "FAIL")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""
+Load test for the sign's HTTP API (or python-test-backend.py --emulate).
+
+Runs concurrent clients for a fixed time and reports latency percentiles,
+throughput and status codes per kind of request:
+
+  upload   POST /api/img with a base64 BMP
+  get      GET /api/img of an uploaded image
+  list     GET /api/listimg
+  stream   POST /api/display at --stream-fps, like a live feed
+
+  python3 load_test.py --esp-ip 192.168.1.42 --uploaders 2 --streams 1 --duration 30
+  python3 load_test.py --esp-ip 127.0.0.1:5000 --uploaders 4 --csv results.csv
+"""
+import argparse
+import base64
+import csv
+import os
+import struct
+import threading
+import time
+from collections import defaultdict
+
+import requests
+
+
+def make_bmp(width, height, seed):
+    """24-bpp BMP with a pattern that differs per seed"""
+    row = (width * 3 + 3) & ~3
+    pixels = bytearray(row * height)
+    for y in range(height):
+        for x in range(width):
+            o = y * row + x * 3
+            pixels[o:o + 3] = bytes(((x * 8 + seed) & 255, (y * 8) & 255, (seed * 40) & 255))
+    header = b"BM" + struct.pack("<IHHI", 54 + len(pixels), 0, 0, 54)
+    info = struct.pack("<IiiHHIIiiII", 40, width, height, 1, 24, 0, len(pixels), 2835, 2835, 0, 0)
+    return header + info + bytes(pixels)
+
+
+class Recorder:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.samples = defaultdict(list)  # kind -> [(latency s, status, bytes)]
+
+    def add(self, kind, latency, status, nbytes):
+        with self.lock:
+            self.samples[kind].append((latency, status, nbytes))
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    i = min(len(sorted_values) - 1, int(round(p / 100 * (len(sorted_values) - 1))))
+    return sorted_values[i]
+
+
+def timed(rec, kind, fn, nbytes):
+    t0 = time.perf_counter()
+    try:
+        r = fn()
+        status = r.status_code
+        if status == 200 and kind in ("get", "list"):
+            nbytes = len(r.content)
+    except requests.RequestException:
+        status = "error"
+    rec.add(kind, time.perf_counter() - t0, status, nbytes)
+    return status
+
+
+def uploader(base_url, rec, deadline, worker, images, names):
+    s = requests.Session()
+    n = 0
+    while time.time() < deadline:
+        name = f"lt_{worker}_{n % len(images)}.bmp"
+        payload = {"file": name, "img": images[n % len(images)]}
+        status = timed(rec, "upload", lambda: s.post(f"{base_url}/api/img", json=payload, timeout=30),
+                       len(payload["img"]))
+        if status == 200 and name not in names:
+            names.append(name)
+        elif status == 503:
+            time.sleep(0.2)  # the device asks for Retry-After: 1, the test keeps the pressure up
+        n += 1
+
+
+def getter(base_url, rec, deadline, names):
+    s = requests.Session()
+    while time.time() < deadline:
+        if not names:
+            time.sleep(0.1)
+            continue
+        name = names[-1]
+        timed(rec, "get", lambda: s.get(f"{base_url}/api/img", params={"file": name}, timeout=30), 0)
+
+
+def lister(base_url, rec, deadline):
+    s = requests.Session()
+    while time.time() < deadline:
+        timed(rec, "list", lambda: s.get(f"{base_url}/api/listimg", timeout=30), 0)
+
+
+def streamer(base_url, rec, deadline, frames, fps, late):
+    s = requests.Session()
+    interval = 1.0 / fps
+    next_t = time.time()
+    n = 0
+    while time.time() < deadline:
+        frame = frames[n % len(frames)]
+        timed(rec, "stream", lambda: s.post(f"{base_url}/api/display", data=frame, timeout=30,
+                                            headers={"Content-Type": "application/octet-stream"}), len(frame))
+        n += 1
+        next_t += interval
+        wait = next_t - time.time()
+        if wait > 0:
+            time.sleep(wait)
+        else:
+            late[0] += 1
+            next_t = time.time()  # don't burst to catch up
+
+
+def report(rec, duration, late, csv_path):
+    rows = []
+    print(f"\n{'kind':7} {'reqs':>6} {'ok':>6} {'503':>5} {'413':>5} {'err':>5} {'req/s':>7} {'KB/s':>8} "
+          f"{'p50 ms':>8} {'p90 ms':>8} {'p99 ms':>8} {'max ms':>8}")
+    for kind in ("upload", "get", "list", "stream"):
+        samples = rec.samples.get(kind)
+        if not samples:
+            continue
+        lat = sorted(s[0] * 1000 for s in samples if s[1] in (200, 204))
+        codes = defaultdict(int)
+        for s in samples:
+            codes[s[1]] += 1
+        ok = codes[200] + codes[204]
+        kb = sum(s[2] for s in samples if s[1] in (200, 204)) / 1024
+        row = {
+            "kind": kind, "requests": len(samples), "ok": ok, "busy503": codes[503],
+            "tooLarge413": codes[413], "errors": len(samples) - ok - codes[503] - codes[413],
+            "reqPerS": ok / duration, "kbPerS": kb / duration,
+            "p50Ms": percentile(lat, 50), "p90Ms": percentile(lat, 90),
+            "p99Ms": percentile(lat, 99), "maxMs": lat[-1] if lat else 0.0,
+        }
+        rows.append(row)
+        print(f"{kind:7} {row['requests']:6d} {ok:6d} {row['busy503']:5d} {row['tooLarge413']:5d} "
+              f"{row['errors']:5d} {row['reqPerS']:7.2f} {row['kbPerS']:8.1f} {row['p50Ms']:8.1f} "
+              f"{row['p90Ms']:8.1f} {row['p99Ms']:8.1f} {row['maxMs']:8.1f}")
+    if "stream" in rec.samples:
+        print(f"stream frames that missed their slot: {late[0]}")
+    if csv_path:
+        with open(csv_path, "w", newline="") as f:
+            w = csv.DictWriter(f, fieldnames=list(rows[0].keys()) if rows else ["kind"])
+            w.writeheader()
+            w.writerows({k: round(v, 2) if isinstance(v, float) else v for k, v in r.items()} for r in rows)
+        print(f"Results saved to {csv_path}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Concurrent load test for the sign's HTTP API")
+    parser.add_argument("--esp-ip", type=str, help="IP (and :port) of the device (overrides $ESP_IP)")
+    parser.add_argument("--duration", type=float, default=20, help="seconds (default 20)")
+    parser.add_argument("--uploaders", type=int, default=2, help="parallel POST /api/img clients")
+    parser.add_argument("--getters", type=int, default=1, help="parallel GET /api/img clients")
+    parser.add_argument("--listers", type=int, default=1, help="parallel GET /api/listimg clients")
+    parser.add_argument("--streams", type=int, default=0, help="parallel POST /api/display streams")
+    parser.add_argument("--stream-fps", type=float, default=10, help="frames per second per stream")
+    parser.add_argument("--size", type=str, help="image WxH (default: the device's /api/imgspec)")
+    parser.add_argument("--csv", type=str, help="write the summary to this CSV file")
+    args = parser.parse_args()
+
+    esp_ip = args.esp_ip or os.environ.get("ESP_IP", "192.168.1.123")
+    base_url = f"http://{esp_ip}"
+    if args.size:
+        width, height = (int(v) for v in args.size.lower().split("x"))
+    else:
+        try:
+            spec = requests.get(f"{base_url}/api/imgspec", timeout=5).json()
+            width, height = spec.get("width", 48), spec.get("height", 48)
+        except Exception as e:
+            raise SystemExit(f"Could not reach {base_url}: {e}")
+
+    frames = [make_bmp(width, height, seed) for seed in range(8)]
+    images = [base64.b64encode(f).decode() for f in frames]
+    print(f"Load test against {base_url} for {args.duration:.0f} s with {width}x{height} images: "
+          f"{args.uploaders} uploader(s), {args.getters} getter(s), {args.listers} lister(s), "
+          f"{args.streams} stream(s) at {args.stream_fps} fps")
+
+    rec = Recorder()
+    names = []  # uploaded so far, read by the getters
+    late = [0]
+    deadline = time.time() + args.duration
+    threads = []
+    threads += [threading.Thread(target=uploader, args=(base_url, rec, deadline, i, images, names))
+                for i in range(args.uploaders)]
+    threads += [threading.Thread(target=getter, args=(base_url, rec, deadline, names))
+                for _ in range(args.getters)]
+    threads += [threading.Thread(target=lister, args=(base_url, rec, deadline))
+                for _ in range(args.listers)]
+    threads += [threading.Thread(target=streamer, args=(base_url, rec, deadline, frames, args.stream_fps, late))
+                for _ in range(args.streams)]
+    started = time.time()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    report(rec, time.time() - started, late, args.csv)
+
+
+if __name__ == "__main__":
+    main()
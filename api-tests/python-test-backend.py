@@ -1,10 +1,12 @@
 #!/usr/bin/env python3
 
 from flask import Flask, request, jsonify, send_from_directory, Response
+import argparse
 import os
 from werkzeug.utils import secure_filename
 import base64
 import json
+import threading
 import time
 
 app = Flask(__name__)
@@ -29,17 +31,146 @@ current_img_chain = {
     "fps": 0.0
 }
 
+# Chain checks like the firmware's ChainValidator: POST /api/imgchain
+# answers with a job id, GET /api/imgchain?job=<id> reports which frames
+# exist. Only the last JOB_SLOTS jobs are kept.
+JOB_SLOTS = 4
+MAX_REPORTED = 16
+chain_jobs = {}
+last_job_id = 0
+
 # Image specifications
 IMG_SPECS = {
     "format": "BMP",
+    "formats": ["BMP", "PNG"],
     "colorspace": "sRGB",
     "width": 48,
     "height": 48,
     "bitDepth": 24,
     "compression": "none",
-    "maxSizeKB": 450
+    "bitDepths": [1, 4, 8, 16, 24],
+    "preferred": {"format": "BMP", "bitDepth": 8, "compression": "none"},
+    "maxSizeKB": 95
 }
 
+# -------------------------------------------------------------------
+# Device emulator (--emulate): the firmware's limits and timing
+#
+# Flask serves requests in parallel; the device doesn't. With --emulate the
+# handlers are slowed down and serialized the way the ESP32 does it:
+#   - one Wi-Fi link: request and response bodies take bytes / wifi rate,
+#     one at a time
+#   - one web task: handlers run one after the other, SD writes and
+#     /api/display decodes included
+#   - one SD bus shared with chain playback (which reads every frame)
+#   - upload slots (http.maxUploads) and free heap for the bodies: 503 with
+#     Retry-After when none is left, 413 above the firmware's body limits
+#   - rendering (decode + LED transfer) on one core
+# Without --emulate the backend answers as fast as it can, as before.
+# -------------------------------------------------------------------
+MAX_IMG_BODY = 128 * 1024      # firmware request body limits (main.cpp)
+MAX_DISPLAY_BODY = 64 * 1024
+HEAP_RESERVE = 16 * 1024       # upload_pool.h
+
+
+class DeviceEmulator:
+    def __init__(self, args):
+        self.wifi_bps = args.wifi_kbps * 1024
+        self.sd_read_bps = args.sd_read_kbps * 1024
+        self.sd_write_bps = args.sd_write_kbps * 1024
+        self.heap = args.heap_kb * 1024
+        self.max_uploads = args.max_uploads
+        self.decode_us_per_px = args.decode_us_per_px
+        self.led_us = args.led_us
+        self.link = threading.Lock()
+        self.web = threading.Lock()
+        self.sd = threading.Lock()
+        self.render_lock = threading.Lock()
+        self.state = threading.Lock()
+        self.active = 0
+        self.buffered = 0
+        self.stats = {"accepted": 0, "busy": 0, "tooLarge": 0}
+        self.busy_ms = {"wifi": 0.0, "web": 0.0, "sd": 0.0, "render": 0.0}
+        self.pixels = IMG_SPECS["width"] * IMG_SPECS["height"]
+
+    def _hold(self, lock, name, seconds):
+        with lock:
+            time.sleep(seconds)
+            self.busy_ms[name] += seconds * 1000
+
+    def transfer(self, nbytes):
+        self._hold(self.link, "wifi", nbytes / self.wifi_bps)
+
+    def sd_write(self, nbytes):
+        self._hold(self.sd, "sd", nbytes / self.sd_write_bps)
+
+    def sd_read(self, nbytes):
+        self._hold(self.sd, "sd", nbytes / self.sd_read_bps)
+
+    def render(self):
+        # decode into the framebuffer + push it to the strip
+        self._hold(self.render_lock, "render", self.pixels * (self.decode_us_per_px + self.led_us) / 1e6)
+
+    def admit(self, nbytes, limit):
+        """Take an upload slot for a body of nbytes, or the error response"""
+        with self.state:
+            if nbytes > limit:
+                self.stats["tooLarge"] += 1
+                return jsonify({"error": "body too large"}), 413
+            if self.active >= self.max_uploads or self.buffered + nbytes + HEAP_RESERVE > self.heap:
+                self.stats["busy"] += 1
+                return jsonify({"error": "busy"}), 503, {"Retry-After": "1"}
+            self.active += 1
+            self.buffered += nbytes
+            self.stats["accepted"] += 1
+        self.transfer(nbytes)
+        return None
+
+    def release(self, nbytes):
+        with self.state:
+            self.active -= 1
+            self.buffered -= nbytes
+
+    def handler(self):
+        """Context manager: runs the handler body on the single web task"""
+        return _Timed(self.web, self.busy_ms, "web")
+
+
+class _Timed:
+    def __init__(self, lock, busy, name):
+        self.lock, self.busy, self.name = lock, busy, name
+
+    def __enter__(self):
+        self.lock.acquire()
+        self.t0 = time.time()
+
+    def __exit__(self, *exc):
+        self.busy[self.name] += (time.time() - self.t0) * 1000
+        self.lock.release()
+
+
+EMU = None  # DeviceEmulator with --emulate
+
+
+def playback_thread():
+    """Emulated chain playback: every frame is read from SD and rendered,
+    competing with the handlers for the bus"""
+    while True:
+        chain, fps = current_img_chain["chain"], current_img_chain["fps"]
+        if not chain or fps <= 0:
+            time.sleep(0.1)
+            continue
+        for fn in list(chain):
+            t0 = time.time()
+            path = os.path.join(IMAGES_DIR, secure_filename(fn))
+            if os.path.isfile(path):
+                EMU.sd_read(os.path.getsize(path))
+                EMU.render()
+            time.sleep(max(0.0, 1.0 / fps - (time.time() - t0)))
+            if current_img_chain["chain"] is not chain:
+                break
+
+
 # -------------------------------------------------------------------
 # /api/img – get / upload single images
 # -------------------------------------------------------------------
@@ -58,6 +189,11 @@ def get_image():
     with open(file_path, 'rb') as f:
         img_data = f.read()
 
+    if EMU:
+        with EMU.handler():
+            EMU.sd_read(len(img_data))
+        EMU.transfer(len(img_data) * 4 // 3)
+
     return jsonify({
         "img": base64.b64encode(img_data).decode('utf-8'),
         "file": filename
@@ -66,14 +202,33 @@ def get_image():
 
 @app.route('/api/img', methods=['POST'])
 def upload_image():
+    if EMU:
+        size = request.content_length or 0
+        err = EMU.admit(size, MAX_IMG_BODY)
+        if err:
+            return err
+        try:
+            with EMU.handler():
+                res = store_image()
+                if res[1] == 200:
+                    EMU.sd_write(res[2])
+                return res[0], res[1]
+        finally:
+            EMU.release(size)
+    res = store_image()
+    return res[0], res[1]
+
+
+def store_image():
+    """Body of POST /api/img: (response, status, bytes written)"""
     data = request.get_json()
     if not data or 'img' not in data or 'file' not in data:
-        return jsonify({"error": "Invalid payload"}), 400
+        return jsonify({"error": "Invalid payload"}), 400, 0
 
     try:
         img_data = base64.b64decode(data['img'])
     except Exception:
-        return jsonify({"error": "Invalid Base64 data"}), 400
+        return jsonify({"error": "Invalid Base64 data"}), 400, 0
 
     safe_filename = secure_filename(data['file'])
     file_path = os.path.join(IMAGES_DIR, safe_filename)
@@ -82,9 +237,45 @@ def upload_image():
         with open(file_path, 'wb') as f:
             f.write(img_data)
     except Exception as e:
-        return jsonify({"error": f"File write error: {str(e)}"}), 500
+        return jsonify({"error": f"File write error: {str(e)}"}), 500, 0
 
-    return jsonify({"file": data['file']})
+    return jsonify({"file": data['file']}), 200, len(img_data)
+
+
+# -------------------------------------------------------------------
+# /api/display – show a raw BMP / PNG body right away
+# -------------------------------------------------------------------
+@app.route('/api/display', methods=['POST'])
+def display_image():
+    size = request.content_length or 0
+    if EMU:
+        err = EMU.admit(size, MAX_DISPLAY_BODY)
+        if err:
+            return err
+        try:
+            with EMU.handler():
+                EMU.render()
+        finally:
+            EMU.release(size)
+    elif size > MAX_DISPLAY_BODY:
+        return jsonify({"error": "body too large"}), 413
+    request.get_data()
+    return "", 204
+
+
+# -------------------------------------------------------------------
+# /api/stats – the emulator's counters (the firmware reports many more)
+# -------------------------------------------------------------------
+@app.route('/api/stats', methods=['GET'])
+def get_stats():
+    if not EMU:
+        return jsonify({"chainLength": len(current_img_chain["chain"])})
+    return jsonify({
+        "chainLength": len(current_img_chain["chain"]),
+        "uploads": dict(EMU.stats, active=EMU.active, max=EMU.max_uploads),
+        "emulator": {"busyMs": {k: round(v) for k, v in EMU.busy_ms.items()},
+                     "bufferedBytes": EMU.buffered},
+    })
 
 
 # -------------------------------------------------------------------
@@ -99,6 +290,9 @@ def list_images():
         f for f in os.listdir(IMAGES_DIR)
         if os.path.isfile(os.path.join(IMAGES_DIR, f))
     ]
+    if EMU:
+        with EMU.handler():
+            EMU.sd_read(len(files) * 32)  # one directory entry each
     return jsonify({"list": files})
 
 
@@ -160,19 +354,34 @@ def set_image_chain():
         with open(chain_path, "w", encoding="utf-8") as f:
             f.write(f"{frame_duration}\n")
             for fn in chain:
-                # Store filenames with ".bmp" extension (always)
+                # Keep the extension (BMP or PNG), bare names are BMPs
                 base = fn
-                if not base.lower().endswith(".bmp"):
+                if "." not in base:
                     base += ".bmp"
                 f.write(f"{base}\n")
     except Exception as e:
         return jsonify({"error": f"fs write chain: {e}"}), 500
 
-    # Update in-memory "currently playing" chain with full filenames
-    current_img_chain["chain"] = chain[:]  # copy list
-    current_img_chain["fps"] = fps
-
-    return jsonify({"status": "ok", "chainNum": str(chain_num)})
+    # Resolve against the images on "SD" and play what exists
+    global last_job_id
+    names = [fn if "." in fn else fn + ".bmp" for fn in chain]
+    t0 = time.perf_counter()
+    resolved = [fn for fn in names if os.path.exists(os.path.join(IMAGES_DIR, secure_filename(fn)))]
+    missing = [fn for fn in names if fn not in resolved]
+    last_job_id += 1
+    chain_jobs[last_job_id] = {
+        "job": last_job_id, "state": "done", "requested": len(names), "resolved": len(resolved),
+        "missingCount": len(missing), "missing": missing[:MAX_REPORTED],
+        "checkUs": int((time.perf_counter() - t0) * 1e6), "started": bool(resolved),
+    }
+    if not resolved:
+        chain_jobs[last_job_id]["error"] = "no frames found"
+    chain_jobs.pop(last_job_id - JOB_SLOTS, None)
+    if resolved:
+        current_img_chain["chain"] = resolved
+        current_img_chain["fps"] = fps
+
+    return jsonify({"status": "ok", "chainNum": str(chain_num), "job": last_job_id})
 
 
 @app.route('/api/imgchain/state', methods=['GET'])
@@ -186,6 +395,13 @@ def get_current_imgchain_state():
 # -------------------------------------------------------------------
 @app.route('/api/imgchain', methods=['GET'])
 def get_imgchain_by_num():
+    job = request.args.get("job")
+    if job is not None:
+        try:
+            return jsonify(chain_jobs[int(job)])
+        except (KeyError, ValueError):
+            return jsonify({"error": "unknown job"}), 404
+
     num = request.args.get("num")
     if not num:
         return jsonify({"error": "missing num"}), 400
@@ -374,4 +590,21 @@ def livestream_page():
 # Main
 # -------------------------------------------------------------------
 if __name__ == '__main__':
-    app.run(host='0.0.0.0', port=5000, debug=True)
+    parser = argparse.ArgumentParser(description="Stand-in for the LED matrix sign's HTTP API")
+    parser.add_argument("--port", type=int, default=5000)
+    parser.add_argument("--emulate", action="store_true",
+                        help="model the device's throughput limits (see DeviceEmulator)")
+    parser.add_argument("--wifi-kbps", type=float, default=700, help="Wi-Fi throughput, KB/s (default 700)")
+    parser.add_argument("--sd-read-kbps", type=float, default=1500, help="SD read rate, KB/s (default 1500)")
+    parser.add_argument("--sd-write-kbps", type=float, default=400, help="SD write rate, KB/s (default 400)")
+    parser.add_argument("--heap-kb", type=int, default=110, help="largest free heap block, KB (default 110)")
+    parser.add_argument("--max-uploads", type=int, default=2, help="http.maxUploads (default 2)")
+    parser.add_argument("--decode-us-per-px", type=float, default=0.3, help="image decode cost (default 0.3)")
+    parser.add_argument("--led-us", type=float, default=30, help="strip transfer per LED, us (default 30, WS2812)")
+    args = parser.parse_args()
+    if args.emulate:
+        EMU = DeviceEmulator(args)
+        threading.Thread(target=playback_thread, daemon=True).start()
+        print(f"Emulating the device: {args.max_uploads} upload slots, {args.heap_kb} KB heap, "
+              f"SD {args.sd_read_kbps:.0f}/{args.sd_write_kbps:.0f} KB/s, Wi-Fi {args.wifi_kbps:.0f} KB/s")
+    app.run(host='0.0.0.0', port=args.port, debug=not args.emulate, threaded=True)
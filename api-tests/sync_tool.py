@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""
+Host-side stand-in for synchronized playback (sync.role in config.json).
+
+  leader  broadcast a chain timeline like a leader sign does
+  follow  run the follower's frame timing and drift correction against the
+          packets, with a simulated clock error, and print how far off it is
+  watch   print the packets on the port (e.g. from a real leader)
+  role    post a config with sync.role set to a device and check that
+          /api/stats reports that role (and, for a leader, that packets come)
+
+Everything works over loopback, so several followers and a leader can run on
+one machine:
+
+  python3 sync_tool.py leader --addr 127.255.255.255 --frames 24 --fps 12
+  python3 sync_tool.py follow --frames 24 --fps 12 --drift-ppm 300
+  python3 sync_tool.py follow --frames 24 --fps 12 --drift-ppm -500 --offset-ms 700
+  python3 sync_tool.py role config.json --esp-ip 192.168.1.42 --role leader
+"""
+import argparse
+import json
+import os
+import random
+import socket
+import struct
+import sys
+import time
+
+PACKET = struct.Struct("<4sBBHII")  # "LMSY", version, chain length, frame ms, generation, position ms
+VERSION = 1
+SYNC_INTERVAL_MS = 200
+
+
+def now_ms():
+    return int(time.monotonic() * 1000)
+
+
+def listen_socket(port):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    s.bind(("", port))
+    return s
+
+
+def parse(data):
+    if len(data) < PACKET.size:
+        return None
+    magic, version, length, frame_ms, generation, pos = PACKET.unpack_from(data)
+    if magic != b"LMSY" or version != VERSION:
+        return None
+    return length, frame_ms, generation, pos
+
+
+def run_leader(args):
+    frame_ms = int(1000 / args.fps)
+    period = args.frames * frame_ms
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    generation = 1
+    start = now_ms()
+    print(f"Leader: {args.frames} frames at {frame_ms} ms to {args.addr}:{args.port}")
+    while True:
+        t = now_ms()
+        if args.restart_s and t - start >= args.restart_s * 1000:
+            generation += 1
+            start = t
+            print(f"Chain restarted (generation {generation})")
+        pos = (t - start) % period
+        s.sendto(PACKET.pack(b"LMSY", VERSION, args.frames, frame_ms, generation, pos), (args.addr, args.port))
+        time.sleep(SYNC_INTERVAL_MS / 1000)
+
+
+class Follower:
+    """The firmware's loop() frame timing and followSync(), on a skewed clock"""
+
+    def __init__(self, frames, frame_ms, drift_ppm, offset_ms):
+        self.frames = frames
+        self.frame_ms = frame_ms
+        self.rate = 1 + drift_ppm / 1e6
+        self.base = time.monotonic()
+        self.offset = offset_ms
+        self.current = 1 % frames  # startChain(): frame 0 is up
+        self.last_update = self.clock()
+        self.generation = 0
+        self.slewed = self.jumps = 0
+        self.error = 0
+
+    def clock(self):
+        return int((time.monotonic() - self.base) * 1000 * self.rate) + self.offset
+
+    def position(self, now):
+        shown = (self.current + self.frames - 1) % self.frames
+        return (shown * self.frame_ms + (now - self.last_update)) % (self.frames * self.frame_ms)
+
+    def step(self):
+        now = self.clock()
+        if now - self.last_update >= self.frame_ms:
+            self.last_update = now + random.randint(0, 2)  # loop() jitter
+            self.current = (self.current + 1) % self.frames
+
+    def on_packet(self, length, frame_ms, generation, pos):
+        if length != self.frames or frame_ms != self.frame_ms:
+            return False
+        now = self.clock()
+        period = self.frames * self.frame_ms
+        err = pos - self.position(now)
+        if err > period // 2:
+            err -= period
+        elif err < -period // 2:
+            err += period
+        self.error = err
+        restarted = generation != self.generation
+        self.generation = generation
+        if not restarted and abs(err) < self.frame_ms:
+            shift = int(err / 4)
+            if shift < 0:
+                shift = -min(-shift, now - self.last_update)
+            self.last_update -= shift
+            self.slewed += 1
+            return True
+        target = pos // self.frame_ms
+        self.last_update = now - pos % self.frame_ms
+        self.current = (target + 1) % self.frames
+        self.jumps += 1
+        return True
+
+
+def run_follower(args):
+    frame_ms = int(1000 / args.fps)
+    f = Follower(args.frames, frame_ms, args.drift_ppm, args.offset_ms)
+    s = listen_socket(args.port)
+    s.setblocking(False)
+    print(f"Follower: {args.frames} frames at {frame_ms} ms, clock {args.drift_ppm:+} ppm, offset {args.offset_ms} ms")
+    next_report = now_ms() + 1000
+    while True:
+        try:
+            while True:
+                p = parse(s.recv(64))
+                if p and not f.on_packet(*p):
+                    print(f"Ignored packet for {p[0]} frames at {p[1]} ms")
+        except BlockingIOError:
+            pass
+        f.step()
+        if now_ms() >= next_report:
+            next_report += 1000
+            print(f"frame {(f.current + f.frames - 1) % f.frames:3d}  error {f.error:+5d} ms  slewed {f.slewed}  jumps {f.jumps}")
+        time.sleep(0.001)
+
+
+def run_watch(args):
+    s = listen_socket(args.port)
+    last = None
+    while True:
+        data, addr = s.recvfrom(64)
+        p = parse(data)
+        t = now_ms()
+        if not p:
+            print(f"{addr[0]}: not a sync packet ({len(data)} bytes)")
+            continue
+        length, frame_ms, generation, pos = p
+        gap = f"{t - last:4d} ms" if last else "    -"
+        last = t
+        print(f"{addr[0]}: gen {generation}  frame {pos // frame_ms:3d}/{length}  pos {pos:6d} ms  every {gap}")
+
+
+def run_role(args):
+    """POST the config with sync.role replaced, read the role back, restore"""
+    import requests
+
+    base = f"http://{args.esp_ip}"
+    with open(args.config, "rb") as f:
+        original = f.read()
+    cfg = json.loads(original)
+    cfg.setdefault("sync", {})["role"] = args.role
+    cfg["sync"]["port"] = args.port
+
+    listener = listen_socket(args.port) if args.role == "leader" else None
+    ok = False
+    try:
+        r = requests.post(f"{base}/api/config", data=json.dumps(cfg), timeout=10)
+        print(f"POST /api/config: {r.status_code} {r.text}")
+        if r.status_code != 200:
+            return 1
+        role = None
+        deadline = time.monotonic() + 3
+        while time.monotonic() < deadline:
+            role = requests.get(f"{base}/api/stats", timeout=5).json().get("sync", {}).get("role", "off")
+            if role == args.role:
+                break
+            time.sleep(0.2)
+        print(f"sync.role: expected {args.role}, device reports {role}")
+        ok = role == args.role
+        if ok and listener:
+            listener.settimeout(2)
+            try:
+                p = parse(listener.recv(64))
+                print(f"Leader packet: {p[0]} frames at {p[1]} ms" if p else "Not a sync packet")
+                ok = p is not None
+            except socket.timeout:
+                print(f"No sync packet on UDP {args.port} within 2 s")
+                ok = False
+    finally:
+        if not args.keep:
+            r = requests.post(f"{base}/api/config", data=original, timeout=10)
+            print(f"Restored {args.config}: {r.status_code}")
+    print("PASS" if ok else "FAIL")
+    return 0 if ok else 1
+
+
+parser = argparse.ArgumentParser(description="Stand-in leader / follower for synchronized playback")
+sub = parser.add_subparsers(dest="mode", required=True)
+for name in ("leader", "follow", "watch", "role"):
+    p = sub.add_parser(name)
+    p.add_argument("--port", type=int, default=4210, help="sync.port (default 4210)")
+    if name in ("leader", "follow"):
+        p.add_argument("--frames", type=int, default=24, help="chain length")
+        p.add_argument("--fps", type=float, default=12, help="chain fps")
+    if name == "leader":
+        p.add_argument("--addr", default="255.255.255.255", help="broadcast address, 127.255.255.255 for loopback")
+        p.add_argument("--restart-s", type=float, default=0, help="restart the chain every N seconds")
+    if name == "follow":
+        p.add_argument("--drift-ppm", type=float, default=0, help="simulated clock rate error")
+        p.add_argument("--offset-ms", type=int, default=0, help="simulated start offset")
+    if name == "role":
+        p.add_argument("config", help="the device's config.json, posted back afterwards")
+        p.add_argument("--esp-ip", default=os.environ.get("ESP_IP", "192.168.1.123"), help="device address (or $ESP_IP)")
+        p.add_argument("--role", choices=("leader", "follower"), default="leader")
+        p.add_argument("--keep", action="store_true", help="leave the changed config on the device")
+args = parser.parse_args()
+sys.exit({"leader": run_leader, "follow": run_follower, "watch": run_watch, "role": run_role}[args.mode](args))
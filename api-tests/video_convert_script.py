@@ -1,16 +1,24 @@
 #!/usr/bin/env python3
 import argparse
 import base64
-import json
+import hashlib
 import os
 import shutil
+import struct
 import subprocess
 import tempfile
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
 
 import requests
 
 
-def get_img_specs(base_url, default_width=480, default_height=320):
+# ffmpeg BMP pixel formats by bit depth (pal8 = 8-bpp palettized, rgb565le = 16-bpp bitfields)
+BMP_PIX_FMTS = {8: "pal8", 16: "rgb565le", 24: "bgr24"}
+
+
+def get_img_specs(base_url, default_width=480, default_height=320, default_depth=24):
     print(f"Fetching image specs from {base_url}/api/imgspec ...")
     try:
         r = requests.get(f"{base_url}/api/imgspec", timeout=5)
@@ -18,82 +26,122 @@ def get_img_specs(base_url, default_width=480, default_height=320):
         specs = r.json()
         width = specs.get("width", default_width)
         height = specs.get("height", default_height)
-        print(f"Using recommended dimensions: {width}x{height}")
-        return width, height
+        # Older firmware only knows 24-bpp and has no "preferred" entry
+        depth = specs.get("preferred", {}).get("bitDepth", specs.get("bitDepth", default_depth))
+        print(f"Using recommended dimensions: {width}x{height}, {depth}-bpp BMP")
+        return width, height, depth
     except Exception as e:
         print(f"Failed to get image specs. Using default {default_width}x{default_height}. Error: {e}")
-        return default_width, default_height
+        return default_width, default_height, default_depth
 
 
-def extract_frames_with_ffmpeg(video_path, width, height, fps, max_frames=None):
+def ffmpeg_frames(video_path, width, height, fps, max_frames=None, bit_depth=24):
+    """Yield the frames as BMP files (bytes) while ffmpeg is still decoding"""
     if not shutil.which("ffmpeg"):
         raise RuntimeError("ffmpeg not found in PATH. Please install ffmpeg.")
 
-    tmp_dir = tempfile.mkdtemp(prefix="esp_video_frames_")
-    print(f"Extracting frames into {tmp_dir} ...")
-
     # Scale + pad to match panel resolution while keeping aspect ratio
     vf_filter = (
         f"scale={width}:{height}:force_original_aspect_ratio=decrease,"
         f"pad={width}:{height}:(ow-iw)/2:(oh-ih)/2"
     )
 
-    output_pattern = os.path.join(tmp_dir, "frame_%05d.bmp")
-
     cmd = [
         "ffmpeg",
-        "-y",  # overwrite
+        "-loglevel", "error",
         "-i", video_path,
         "-vf", vf_filter,
         "-r", str(fps),
+        "-pix_fmt", BMP_PIX_FMTS.get(bit_depth, "bgr24"),
     ]
 
     if max_frames is not None:
         cmd.extend(["-frames:v", str(max_frames)])
 
-    cmd.append(output_pattern)
+    # one BMP after the other on stdout, each starts with "BM" + u32 file size
+    cmd.extend(["-f", "image2pipe", "-c:v", "bmp", "-"])
 
     print("Running:", " ".join(cmd))
-    subprocess.run(cmd, check=True)
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+    try:
+        while True:
+            head = proc.stdout.read(6)
+            if len(head) < 6:
+                break
+            if head[:2] != b"BM":
+                raise RuntimeError("Unexpected data from ffmpeg (not a BMP stream)")
+            size = struct.unpack_from("<I", head, 2)[0]
+            body = proc.stdout.read(size - 6)
+            if len(body) < size - 6:
+                raise RuntimeError("ffmpeg output ended inside a frame")
+            yield head + body
+    finally:
+        proc.stdout.close()
+        if proc.wait() != 0:
+            raise RuntimeError(f"ffmpeg failed with exit code {proc.returncode}")
 
-    # Collect generated frames
-    frames = sorted(
-        os.path.join(tmp_dir, f)
-        for f in os.listdir(tmp_dir)
-        if f.lower().endswith(".bmp")
-    )
 
-    if not frames:
-        raise RuntimeError("No frames were generated by ffmpeg.")
+def device_upload_slots(base_url, default=2):
+    """How many uploads the device accepts at once (http.maxUploads)"""
+    try:
+        r = requests.get(f"{base_url}/api/stats", timeout=5)
+        r.raise_for_status()
+        return r.json().get("uploads", {}).get("max", default)
+    except Exception:
+        return default
 
-    print(f"Generated {len(frames)} frame(s).")
-    return tmp_dir, frames
+
+def device_images(base_url, prefix):
+    """Names under /images/ starting with prefix (best effort, the device
+    cuts long listings short)"""
+    try:
+        r = requests.get(f"{base_url}/api/listimg", params={"contains": prefix}, timeout=10)
+        r.raise_for_status()
+        return {n for n in r.json().get("list", []) if n.lower().startswith(prefix.lower())}
+    except Exception as e:
+        print(f"Could not list images on the device ({e}), relying on the resume file")
+        return set()
 
 
-def upload_frame(base_url, frame_path):
-    filename = os.path.basename(frame_path)
-    with open(frame_path, "rb") as f:
-        bmp_base64 = base64.b64encode(f.read()).decode()
+_session = threading.local()
 
+
+def upload_frame(base_url, filename, data, retries=5):
+    """POST one BMP to /api/img, retrying while the device is busy (503) or
+    the connection fails"""
+    if not hasattr(_session, "s"):
+        _session.s = requests.Session()
     payload = {
         "file": filename,
-        "img": bmp_base64,
+        "img": base64.b64encode(data).decode(),
     }
 
     url = f"{base_url}/api/img"
-    r = requests.post(url, json=payload)
-    try:
-        body = r.json()
-    except Exception:
-        body = r.text
-
-    if r.status_code != 200:
+    delay = 0.5
+    for attempt in range(1, retries + 1):
+        try:
+            r = _session.s.post(url, json=payload, timeout=30)
+        except requests.RequestException as e:
+            if attempt == retries:
+                raise RuntimeError(f"Failed to upload {filename}: {e}")
+            time.sleep(delay)
+            delay *= 2
+            continue
+
+        if r.status_code == 200:
+            return filename
+        if r.status_code == 503 and attempt < retries:
+            time.sleep(float(r.headers.get("Retry-After", delay)))
+            delay *= 2
+            continue
+        try:
+            body = r.json()
+        except Exception:
+            body = r.text
         raise RuntimeError(
             f"Failed to upload {filename}: {r.status_code} {body}"
         )
 
-    return filename
-
 
 def create_img_chain(base_url, filenames, fps, chain_num=0):
     url = f"{base_url}/api/imgchain"
@@ -117,6 +165,24 @@ def create_img_chain(base_url, filenames, fps, chain_num=0):
     print("Chain created successfully.")
     print("Device response:", body)
 
+    # The device checks the frames in the background; report what it found
+    job = body.get("job") if isinstance(body, dict) else None
+    if job is None:
+        return
+    for _ in range(50):
+        try:
+            result = requests.get(url, params={"job": job}, timeout=5).json()
+        except (requests.RequestException, ValueError):
+            return
+        if result.get("state") == "done":
+            if result.get("missingCount"):
+                print(f"Warning: {result['missingCount']} frame(s) not on the device and skipped: "
+                      f"{', '.join(result.get('missing', []))}")
+            if result.get("error"):
+                print(f"Chain not started: {result['error']}")
+            return
+        time.sleep(0.1)
+
 
 def main():
     parser = argparse.ArgumentParser(
@@ -145,11 +211,31 @@ def main():
         type=int,
         help="Optional limit on number of frames to extract & upload",
     )
+    parser.add_argument(
+        "--bit-depth",
+        type=int,
+        choices=sorted(BMP_PIX_FMTS),
+        help="BMP bit depth to emit (default: the device's preferred format)",
+    )
     parser.add_argument(
         "--keep-frames",
         action="store_true",
         help="Keep generated BMP frames on disk (for debugging).",
     )
+    parser.add_argument(
+        "--jobs",
+        type=int,
+        help="Parallel uploads (default: as many as the device accepts, http.maxUploads)",
+    )
+    parser.add_argument(
+        "--prefix",
+        default="v_",
+        help="Device file name prefix, followed by the frame's content hash (default: v_)",
+    )
+    parser.add_argument(
+        "--state",
+        help="Resume file listing frames already uploaded (default: <video>.<esp-ip>.uploaded)",
+    )
 
     args = parser.parse_args()
 
@@ -161,36 +247,77 @@ def main():
         raise SystemExit(f"Video file not found: {args.video}")
 
     # 1. Get image specs from device
-    width, height = get_img_specs(base_url)
-
-    # 2. Extract frames from video
-    frames_dir = None
-    try:
-        frames_dir, frame_paths = extract_frames_with_ffmpeg(
+    width, height, bit_depth = get_img_specs(base_url)
+    if args.bit_depth:
+        bit_depth = args.bit_depth
+
+    # 2. Extract, hash and upload at the same time: ffmpeg streams the
+    #    frames, each is named after its content, and up to --jobs uploads
+    #    run in parallel. Names the device already has (from the listing or
+    #    the resume file of an earlier run) and repeated frames aren't sent
+    #    again; they only appear again in the chain.
+    jobs = args.jobs or device_upload_slots(base_url)
+    state_path = args.state or f"{os.path.splitext(args.video)[0]}.{esp_ip}.uploaded"
+    present = device_images(base_url, args.prefix)
+    if os.path.isfile(state_path):
+        with open(state_path) as f:
+            present |= {line.strip() for line in f if line.strip()}
+    print(f"Uploading with {jobs} connection(s), {len(present)} frame(s) already on the device")
+
+    frames_dir = tempfile.mkdtemp(prefix="esp_video_frames_") if args.keep_frames else None
+    chain = []
+    queued = set(present)
+    failed = []
+    done = 0
+    inflight = threading.BoundedSemaphore(jobs * 2)  # frames held in memory
+    lock = threading.Lock()
+    started = time.time()
+
+    with open(state_path, "a") as state, ThreadPoolExecutor(max_workers=jobs) as pool:
+
+        def finished(fut, name):
+            nonlocal done
+            inflight.release()
+            with lock:
+                if fut.exception():
+                    failed.append(name)
+                    print(fut.exception())
+                    return
+                done += 1
+                state.write(name + "\n")
+                state.flush()
+                print(f"Uploaded {name} ({done} new, {len(chain)} frames so far)")
+
+        for data in ffmpeg_frames(
             video_path=args.video,
             width=width,
             height=height,
             fps=args.fps,
             max_frames=args.max_frames,
-        )
-
-        # 3. Upload frames
-        uploaded_filenames = []
-        for i, frame in enumerate(frame_paths, 1):
-            print(f"Uploading frame {i}/{len(frame_paths)}: {os.path.basename(frame)}")
-            filename_on_device = upload_frame(base_url, frame)
-            uploaded_filenames.append(filename_on_device)
-
-        # 4. Create image chain on device (this typically starts playback, depending on firmware)
-        create_img_chain(base_url, uploaded_filenames, fps=args.fps, chain_num=args.chain_num)
-
-    finally:
-        # 5. Clean up
-        if frames_dir and not args.keep-frames:
-            shutil.rmtree(frames_dir, ignore_errors=True)
-            print(f"Cleaned up temporary frames in {frames_dir}")
-        elif frames_dir:
-            print(f"Frames kept in {frames_dir}")
+            bit_depth=bit_depth,
+        ):
+            name = f"{args.prefix}{hashlib.sha1(data).hexdigest()[:12]}.bmp"
+            chain.append(name)
+            if frames_dir:
+                with open(os.path.join(frames_dir, f"frame_{len(chain):05d}.bmp"), "wb") as f:
+                    f.write(data)
+            if name in queued:
+                continue
+            queued.add(name)
+            inflight.acquire()
+            fut = pool.submit(upload_frame, base_url, name, data)
+            fut.add_done_callback(lambda fut, name=name: finished(fut, name))
+
+    if frames_dir:
+        print(f"Frames kept in {frames_dir}")
+    if not chain:
+        raise SystemExit("No frames were generated by ffmpeg.")
+    print(f"{len(chain)} frame(s), {len(set(chain))} distinct, {done} uploaded in {time.time() - started:.1f} s")
+    if failed:
+        raise SystemExit(f"{len(failed)} upload(s) failed, run again to resume")
+
+    # 3. Create image chain on device (this typically starts playback, depending on firmware)
+    create_img_chain(base_url, chain, fps=args.fps, chain_num=args.chain_num)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,140 @@
+// chain_sync.h
+#pragma once
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "matrix_driver.h"
+
+// ——— Chain timeline shared between controllers over UDP (sync.role) ———
+// The timeline position is the time into the current pass of the chain:
+// chain index * frame duration + how long that frame has been up. The
+// leader broadcasts it every SYNC_INTERVAL_MS and whenever a chain starts;
+// followers playing a chain of the same length and frame duration pull
+// their own loop() timing towards it (see followSync() in main.cpp).
+// Packet, little endian:
+//   "LMSY", u8 version, u8 chain length, u16 frame ms, u32 generation
+//   (bumped on every chain start), u32 position ms
+class ChainSync
+{
+public:
+    static const uint16_t SYNC_INTERVAL_MS = 200;
+    static const uint8_t VERSION = 1;
+
+    struct Stats
+    {
+        uint32_t sent = 0;
+        uint32_t received = 0;
+        uint32_t ignored = 0; // malformed, or for another chain length / frame duration
+        uint32_t slewed = 0;  // small corrections of the frame timing
+        uint32_t jumps = 0;   // chain starts / more than a frame off: jumped to the leader's frame
+        int32_t errorMs = 0;  // leader position - own position at the last packet
+    } stats;
+
+    ChainSync() : lock(xSemaphoreCreateMutex()) {}
+
+    // (Re)start in `role` on UDP `port`
+    void begin(uint8_t role, uint16_t port)
+    {
+        udp.close();
+        this->role = role;
+        this->port = port;
+        fresh = false;
+        if (role == SYNC_FOLLOWER && udp.listen(port))
+            udp.onPacket([this](AsyncUDPPacket &p)
+                         { receive(p.data(), p.length(), millis()); });
+        if (role != SYNC_OFF)
+            Serial.printf("🔗 Sync %s on UDP %u\n", role == SYNC_LEADER ? "leader" : "follower", port);
+    }
+
+    bool leading() const { return role == SYNC_LEADER; }
+    bool following() const { return role == SYNC_FOLLOWER; }
+    uint8_t currentRole() const { return role; }
+
+    // Leader: a chain was started, tell the followers right away
+    void restart()
+    {
+        generation++;
+        nextSend = millis();
+    }
+
+    // Leader, from loop(): broadcast position `pos` when it is due
+    void announce(uint32_t now, uint32_t pos, uint8_t len, uint16_t frameMs)
+    {
+        if (int32_t(now - nextSend) < 0)
+            return;
+        nextSend = now + SYNC_INTERVAL_MS;
+        uint8_t b[PACKET_BYTES] = {'L', 'M', 'S', 'Y', VERSION, len};
+        put16(b + 6, frameMs);
+        put32(b + 8, generation);
+        put32(b + 12, pos);
+        if (udp.broadcastTo(b, sizeof(b), port))
+            stats.sent++;
+    }
+
+    // Follower, from loop(): the leader's position at `now` if a packet for
+    // a chain of `len` frames of `frameMs` arrived since the last call.
+    // `restarted` is set if the leader started its chain since the last one.
+    bool take(uint32_t now, uint8_t len, uint16_t frameMs, uint32_t &pos, bool &restarted)
+    {
+        Packet p;
+        {
+            LockGuard g(lock);
+            if (!fresh)
+                return false;
+            fresh = false;
+            p = last;
+        }
+        if (p.len != len || p.frameMs != frameMs || !len || !frameMs)
+        {
+            stats.ignored++;
+            return false;
+        }
+        pos = (p.pos + (now - p.rxMillis)) % (uint32_t(len) * frameMs);
+        restarted = p.generation != seenGeneration;
+        seenGeneration = p.generation;
+        return true;
+    }
+
+private:
+    static const size_t PACKET_BYTES = 16;
+    struct Packet
+    {
+        uint8_t len = 0;
+        uint16_t frameMs = 0;
+        uint32_t generation = 0, pos = 0, rxMillis = 0;
+    };
+
+    AsyncUDP udp;
+    SemaphoreHandle_t lock; // `last` is written by the UDP task, read by loop()
+    uint8_t role = SYNC_OFF;
+    uint16_t port = 0;
+    uint32_t generation = 0, seenGeneration = 0;
+    uint32_t nextSend = 0;
+    Packet last;
+    bool fresh = false;
+
+    static void put16(uint8_t *b, uint16_t v) { b[0] = v, b[1] = v >> 8; }
+    static void put32(uint8_t *b, uint32_t v) { put16(b, v), put16(b + 2, v >> 16); }
+    static uint16_t get16(const uint8_t *b) { return b[0] | b[1] << 8; }
+    static uint32_t get32(const uint8_t *b) { return get16(b) | uint32_t(get16(b + 2)) << 16; }
+
+    void receive(const uint8_t *b, size_t n, uint32_t now)
+    {
+        if (n < PACKET_BYTES || memcmp(b, "LMSY", 4) || b[4] != VERSION)
+        {
+            stats.ignored++;
+            return;
+        }
+        LockGuard g(lock);
+        last.len = b[5];
+        last.frameMs = get16(b + 6);
+        last.generation = get32(b + 8);
+        last.pos = get32(b + 12);
+        last.rxMillis = now;
+        fresh = true;
+        stats.received++;
+    }
+};
@@ -0,0 +1,215 @@
+// chain_validator.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <vector>
+#include "frame_store.h"
+#include "image_index.h"
+
+// ——— Checks posted chains against the image index off the web task ———
+// POST /api/imgchain only queues a job and answers with its id; a task
+// builds the ImageIndex once at boot and then resolves each job into the
+// frames that exist (on SD or in the flash tier), in chain order. loop()
+// takes the newest resolved chain and plays it, so the player never tries
+// a file that isn't there. The last JOB_SLOTS jobs can be polled by id.
+class ChainValidator
+{
+public:
+    static const uint8_t JOB_SLOTS = 4;
+    static const uint8_t MAX_REPORTED = 16; // missing names kept per job
+
+    enum JobState : uint8_t
+    {
+        JOB_UNKNOWN, // never submitted, or pushed out by newer jobs
+        JOB_QUEUED,  // waiting for the index or the task
+        JOB_DONE,
+    };
+
+    // What GET /api/imgchain?job= reports
+    struct Result
+    {
+        uint8_t state = JOB_UNKNOWN;
+        uint8_t requested = 0, resolved = 0, missing = 0;
+        bool started = false; // taken by loop() and played
+        uint32_t micros = 0;  // time to resolve, not counting the wait for the index
+        std::vector<String> missingNames;
+    };
+
+    struct Stats
+    {
+        uint32_t jobs = 0;
+        uint32_t missingFrames = 0; // dropped from resolved chains
+        uint32_t busy = 0;          // submits refused, every slot still queued
+    } stats;
+
+    ChainValidator(ImageIndex &index, FlashFrameStore *flash = nullptr)
+        : index(index), flash(flash), lock(xSemaphoreCreateMutex())
+    {
+        xTaskCreate(taskEntry, "chaincheck", 6144, this, 1, &task);
+    }
+
+    // A submit() now would get a slot. Only the web task submits and slots
+    // only free up meanwhile, so it still will after some other work.
+    bool canSubmit()
+    {
+        LockGuard g(lock);
+        for (const Job &j : jobs)
+            if (j.state != JOB_QUEUED)
+                return true;
+        return false;
+    }
+
+    // Queue `len` frames at `frameMs`; `pin` is handed back with the result.
+    // Returns the job id, 0 if all slots are still waiting.
+    uint32_t submit(const String *chain, uint8_t len, uint16_t frameMs, bool pin)
+    {
+        uint32_t id;
+        {
+            LockGuard g(lock);
+            Job *slot = nullptr;
+            for (Job &j : jobs)
+                if (j.state != JOB_QUEUED && (!slot || j.id < slot->id))
+                    slot = &j;
+            if (!slot)
+            {
+                stats.busy++;
+                return 0;
+            }
+            id = ++lastId;
+            *slot = Job();
+            slot->id = id;
+            slot->state = JOB_QUEUED;
+            slot->frameMs = frameMs;
+            slot->pin = pin;
+            slot->requested = len;
+            slot->frames.assign(chain, chain + len);
+            newest = id;
+            stats.jobs++;
+        }
+        xTaskNotifyGive(task);
+        return id;
+    }
+
+    bool result(uint32_t id, Result &out)
+    {
+        LockGuard g(lock);
+        const Job *j = find(id);
+        if (!j)
+            return false;
+        out.state = j->state;
+        out.requested = j->requested;
+        out.resolved = j->state == JOB_DONE ? j->frames.size() : 0;
+        out.missing = j->missing;
+        out.started = j->taken;
+        out.micros = j->micros;
+        out.missingNames = j->missingNames;
+        return true;
+    }
+
+    // loop(): the newest submitted chain once it is resolved, if it has any
+    // frames left. Each job is handed out once; older ones are skipped.
+    bool take(String *chain, uint8_t max, uint8_t &len, uint16_t &frameMs, bool &pin)
+    {
+        LockGuard g(lock);
+        Job *j = find(newest);
+        if (!j || j->state != JOB_DONE || j->taken || j->frames.empty())
+            return false;
+        len = std::min<size_t>(j->frames.size(), max);
+        for (uint8_t i = 0; i < len; i++)
+            chain[i] = j->frames[i];
+        frameMs = j->frameMs;
+        pin = j->pin;
+        j->taken = true;
+        return true;
+    }
+
+private:
+    struct Job
+    {
+        uint32_t id = 0;
+        uint8_t state = JOB_UNKNOWN;
+        uint16_t frameMs = 0;
+        bool pin = false, taken = false;
+        uint8_t requested = 0, missing = 0;
+        uint32_t micros = 0;
+        std::vector<String> frames; // requested, then resolved
+        std::vector<String> missingNames;
+    };
+
+    ImageIndex &index;
+    FlashFrameStore *flash;
+    SemaphoreHandle_t lock; // jobs, ids
+    TaskHandle_t task = nullptr;
+    Job jobs[JOB_SLOTS];
+    uint32_t lastId = 0, newest = 0;
+
+    static void taskEntry(void *arg) { static_cast<ChainValidator *>(arg)->run(); }
+
+    Job *find(uint32_t id)
+    {
+        for (Job &j : jobs)
+            if (id && j.id == id)
+                return &j;
+        return nullptr;
+    }
+
+    void run()
+    {
+        index.scan();
+        for (;;)
+        {
+            while (resolveNext())
+                ;
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+
+    // Resolve the oldest queued job, false if there is none
+    bool resolveNext()
+    {
+        uint32_t id = 0;
+        std::vector<String> frames;
+        {
+            LockGuard g(lock);
+            for (Job &j : jobs)
+                if (j.state == JOB_QUEUED && (!id || j.id < id))
+                    id = j.id;
+            if (!id)
+                return false;
+            frames = find(id)->frames;
+        }
+
+        uint32_t t0 = micros();
+        std::vector<String> resolved, missingNames;
+        resolved.reserve(frames.size());
+        uint8_t missing = 0;
+        for (const String &fn : frames)
+        {
+            if (index.contains(fn) || (flash && flash->contains(fn.c_str())))
+            {
+                resolved.push_back(fn);
+                continue;
+            }
+            if (missing++ < MAX_REPORTED)
+                missingNames.push_back(fn);
+        }
+        if (missing)
+            Serial.printf("⚠️ Chain job %u: %u of %u frames not found, skipped\n",
+                          unsigned(id), missing, unsigned(frames.size()));
+
+        LockGuard g(lock);
+        Job *j = find(id);
+        if (!j)
+            return true;
+        j->frames.swap(resolved);
+        j->missing = missing;
+        j->missingNames.swap(missingNames);
+        j->micros = micros() - t0;
+        j->state = JOB_DONE;
+        stats.missingFrames += missing;
+        return true;
+    }
+};
@@ -0,0 +1,222 @@
+// compositor.h
+#pragma once
+
+#include <Arduino.h>
+#include <algorithm>
+#include <vector>
+
+// Pixel rectangle [x0, x1) x [y0, y1) in matrix coordinates
+struct Rect
+{
+    int16_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+    Rect() {}
+    Rect(int16_t x0, int16_t y0, int16_t x1, int16_t y1) : x0(x0), y0(y0), x1(x1), y1(y1) {}
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+    uint32_t area() const { return empty() ? 0 : uint32_t(x1 - x0) * (y1 - y0); }
+    bool operator==(const Rect &o) const { return x0 == o.x0 && y0 == o.y0 && x1 == o.x1 && y1 == o.y1; }
+
+    // Smallest rect covering both
+    Rect operator|(const Rect &o) const
+    {
+        if (empty())
+            return o;
+        if (o.empty())
+            return *this;
+        return Rect(std::min(x0, o.x0), std::min(y0, o.y0), std::max(x1, o.x1), std::max(y1, o.y1));
+    }
+    // Overlap, empty if none
+    Rect operator&(const Rect &o) const
+    {
+        Rect r(std::max(x0, o.x0), std::max(y0, o.y0), std::min(x1, o.x1), std::min(y1, o.y1));
+        return r.empty() ? Rect() : r;
+    }
+};
+
+// Placement and blending of one overlay layer
+struct LayerProps
+{
+    int16_t x = 0, y = 0;   // top-left on the matrix, may be partly off it
+    uint16_t w = 0, h = 0;  // pixel size
+    uint8_t alpha = 255;    // 255 = opaque
+    bool keyed = false;     // pixels equal to key are transparent
+    uint8_t key[3] = {0, 0, 0};
+    int8_t z = 0;           // higher is on top, the background is below all
+    bool visible = true;
+
+    Rect rect() const { return Rect(x, y, x + w, y + h); }
+};
+
+// ——— Overlay layers over the background framebuffer ———
+// Layers are RGB888 bitmaps stacked by z over the frame the decoders and the
+// chain player write. Callers collect the area a change touched (the Rect
+// returned by set()/remove()) and compose() only redoes that area of the
+// output, so a ticking clock costs its own size, not the matrix.
+// Not locked itself: MatrixDriver calls it under showLock.
+class Compositor
+{
+public:
+    static const uint8_t MAX_LAYERS = 8;
+
+    struct Stats
+    {
+        uint32_t composed = 0;       // compose() calls
+        uint32_t composedPixels = 0; // area of the last one
+        uint32_t composeMicros = 0;  // last one
+    } stats;
+
+    // New matrix size: layers were placed for the old one and are dropped
+    void resize(uint16_t w, uint16_t h)
+    {
+        width = w;
+        height = h;
+        layers.clear();
+        std::vector<uint8_t>().swap(out);
+    }
+
+    bool empty() const { return layers.empty(); }
+    uint8_t size() const { return layers.size(); }
+    Rect bounds() const { return Rect(0, 0, width, height); }
+    const uint8_t *output() const { return out.data(); }
+
+    // Settings of layer `id`, false if there is none
+    bool get(uint8_t id, LayerProps &p) const
+    {
+        const Layer *l = find(id);
+        if (l)
+            p = l->p;
+        return l;
+    }
+
+    // Create or change layer `id`. px: p.w * p.h RGB888 pixels, taken over
+    // by the layer; nullptr keeps the current ones (same w/h required).
+    // `changed` gets the area to recompose. False if all layers are taken
+    // or the pixels don't match the size.
+    bool set(uint8_t id, const LayerProps &p, std::vector<uint8_t> *px, Rect &changed)
+    {
+        Layer *l = find(id);
+        if (!l && (!px || layers.size() >= MAX_LAYERS))
+            return false;
+        if (px ? px->size() != size_t(p.w) * p.h * 3 : (p.w != l->p.w || p.h != l->p.h))
+            return false;
+        bool fresh = false;
+        if (!l)
+        {
+            // output buffer only exists once there is something to compose,
+            // and is not kept up to date while there are no layers
+            if (layers.empty())
+            {
+                if (out.empty())
+                    out.assign(size_t(width) * height * 3, 0);
+                fresh = true;
+            }
+            layers.push_back(Layer());
+            l = &layers.back();
+            l->id = id;
+            l->p = p;
+        }
+        // a new or stale output buffer has to be composed whole once, it is read back
+        changed = fresh ? bounds() : l->area() | areaOf(p);
+        l->p = p;
+        if (px)
+            l->px.swap(*px);
+        // z order, layers with equal z keep the order they were added in
+        std::stable_sort(layers.begin(), layers.end(),
+                         [](const Layer &a, const Layer &b)
+                         { return a.p.z < b.p.z; });
+        return true;
+    }
+
+    // Drop layer `id`; returns the area it covered
+    Rect remove(uint8_t id)
+    {
+        for (auto it = layers.begin(); it != layers.end(); ++it)
+        {
+            if (it->id == id)
+            {
+                Rect r = it->area();
+                layers.erase(it);
+                return r;
+            }
+        }
+        return Rect();
+    }
+
+    // Redo area r of the output from the background bg (same size as the
+    // output) and the layers
+    void compose(const uint8_t *bg, Rect r)
+    {
+        r = r & bounds();
+        if (r.empty())
+            return;
+        uint32_t t0 = micros();
+        size_t span = size_t(r.x1 - r.x0) * 3;
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            size_t off = (size_t(y) * width + r.x0) * 3;
+            memcpy(&out[off], bg + off, span);
+        }
+        for (const Layer &l : layers)
+        {
+            Rect lr = r & l.area();
+            if (lr.empty())
+                continue;
+            int n = lr.x1 - lr.x0;
+            for (int y = lr.y0; y < lr.y1; y++)
+            {
+                const uint8_t *s = &l.px[(size_t(y - l.p.y) * l.p.w + (lr.x0 - l.p.x)) * 3];
+                blendRow(&out[(size_t(y) * width + lr.x0) * 3], s, n, l.p);
+            }
+        }
+        stats.composed++;
+        stats.composedPixels = r.area();
+        stats.composeMicros = micros() - t0;
+    }
+
+private:
+    struct Layer
+    {
+        uint8_t id = 0;
+        LayerProps p;
+        std::vector<uint8_t> px; // p.w * p.h RGB888
+
+        Rect area() const { return areaOf(p); }
+    };
+    uint16_t width = 0, height = 0;
+    std::vector<Layer> layers; // by z, bottom first
+    std::vector<uint8_t> out;  // composited RGB888, what the blit reads; allocated with the first layer
+
+    // Area a layer with these settings paints, empty if it paints nothing
+    static Rect areaOf(const LayerProps &p)
+    {
+        return p.visible && p.alpha ? p.rect() : Rect();
+    }
+
+    Layer *find(uint8_t id)
+    {
+        for (auto &l : layers)
+            if (l.id == id)
+                return &l;
+        return nullptr;
+    }
+    const Layer *find(uint8_t id) const { return const_cast<Compositor *>(this)->find(id); }
+
+    static void blendRow(uint8_t *d, const uint8_t *s, int n, const LayerProps &p)
+    {
+        if (p.alpha == 255 && !p.keyed)
+        {
+            memcpy(d, s, size_t(n) * 3);
+            return;
+        }
+        uint16_t a = uint16_t(p.alpha) + 1, ia = 256 - a;
+        for (int i = 0; i < n; i++, d += 3, s += 3)
+        {
+            if (p.keyed && s[0] == p.key[0] && s[1] == p.key[1] && s[2] == p.key[2])
+                continue;
+            d[0] = (s[0] * a + d[0] * ia) >> 8;
+            d[1] = (s[1] * a + d[1] * ia) >> 8;
+            d[2] = (s[2] * a + d[2] * ia) >> 8;
+        }
+    }
+};
@@ -6,7 +6,9 @@
 #endif
 
 #include <SPI.h>
-#include <SD.h>
+#include "sd_storage.h"
+#include "virtual_file.h"
+#include "led_output.h"
 #include <WiFi.h>
 #include <ArduinoJson.h>
 #include <AsyncTCP.h>
@@ -29,6 +31,11 @@ DNSServer dnsServer;
 
 // Path to JSON configuration on SD card
 constexpr char CONFIG_PATH[] = "/config.json";
+// Uploaded images; playback builds paths into fixed IMAGE_PATH_MAX buffers
+constexpr char IMAGES_DIR[] = "/images/";
+#define IMAGE_PATH_MAX 96
+// Compiled form of CONFIG_PATH (settings, panels, LED map), rebuilt when the JSON changes
+constexpr char CONFIG_CACHE_PATH[] = "/config.bin";
 #if !SD_CS
 #define SD_CS 22
 #endif
@@ -42,6 +49,26 @@ constexpr char CONFIG_PATH[] = "/config.json";
 #if !SD_SCK
 #define SD_SCK SCK
 #endif
+// Fastest SD SPI clock to try, lower steps are negotiated if the card fails
+#if !SD_MAX_MHZ
+#define SD_MAX_MHZ 25
+#endif
+// Largest matrix a config may describe (framebuffer is 3 bytes per pixel)
+#define MAX_MATRIX_PIXELS (128 * 128)
+
+static uint32_t fnv1a(const uint8_t *p, size_t n, uint32_t h = 2166136261u)
+{
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+// IMAGES_DIR + name into out (IMAGE_PATH_MAX bytes) without touching the
+// heap; false if it doesn't fit
+static bool imagePath(char *out, const char *name)
+{
+    return snprintf(out, IMAGE_PATH_MAX, "%s%s", IMAGES_DIR, name) < IMAGE_PATH_MAX;
+}
 
 // ——— Per-panel layout using WLED flags ———
 struct PanelConfig
@@ -54,15 +81,50 @@ struct PanelConfig
     bool serpentine;  // 's' zig-zag every other strip
 };
 
+// How source images of a different size are fitted to the matrix
+enum ScaleMode : uint8_t
+{
+    SCALE_NEAREST, // sample one source pixel (fast, reads only sampled rows)
+    SCALE_AREA,    // average the covered source block when downscaling
+};
+
+// Role in synchronized playback across controllers (chain_sync.h)
+enum SyncRole : uint8_t
+{
+    SYNC_OFF,
+    SYNC_LEADER,   // broadcasts its chain timeline
+    SYNC_FOLLOWER, // follows the leader's
+};
+
 class ConfigReader
 {
 public:
     // LEDs + matrix
     uint16_t totalLEDs, startLED, stripLen, skipLEDs;
     uint8_t pin, order;
+    uint8_t ledType;   // WLED bus type (22 WS2812, 24 WS2811 400kHz, 30 SK6812 RGBW, 51 APA102)
+    uint8_t clockPin;  // second pin for clocked types, 0xFF if none
+    uint16_t spiKHz;   // clock rate for clocked types
+    uint16_t maxPowerMa = 0; // current budget of the output in mA, 0 = no limiter
+    uint8_t ledMa = 55;      // mA one LED draws at full white
     bool reverse;
-    uint16_t width, height;
+    uint16_t matrixWidth, matrixHeight; // LEDs as laid out by the panels
     std::vector<PanelConfig> panels;
+    // Display transform (top-level "transform"), folded into the LED map:
+    // content pixel (x, y) is shown at (x - viewX, y - viewY) of the view,
+    // mirrored, then rotated clockwise onto the panels
+    uint16_t rotate = 0; // 0, 90, 180 or 270
+    bool flipX = false, flipY = false;
+    int16_t viewX = 0, viewY = 0;
+    uint16_t width, height; // framebuffer: what images are scaled to
+    uint8_t scaleMode = SCALE_NEAREST;
+    uint8_t prefetchFrames = 3; // read-ahead ring slots, 0 = decode in loop()
+    uint8_t flashLoops = 0;     // mirror a chain to flash after this many loops, 0 = only pinned chains
+    uint8_t crossfadeFps = 0;   // blended output frames per second between chain frames, 0 = off
+    uint8_t maxUploads = 2;     // POST bodies buffered at the same time
+    uint8_t jsonArenaKB = 8;    // block for the handlers' JSON documents, 0 = heap only
+    uint8_t syncRole = SYNC_OFF;
+    uint16_t syncPort = 4210;   // UDP port of the sync timeline
 
     // Wi-Fi
     String wifiSsid;
@@ -74,6 +136,13 @@ public:
     uint8_t apChannel = WIFI_CHANNEL;
     bool apHidden = false;
 
+    // (x,y) → LED index when it came from the cache, else empty (the driver
+    // builds it and hands it to saveCache())
+    std::vector<int32_t> ledMap;
+
+    // Why the last load() / validate() failed
+    String error;
+
     bool loadFromSD(const char *path)
     {
         // Serial.printf("Checking SD card at Pins: CS=%d, MOSI=%d, MISO=%d, SCK=%d\n", SD_CS, SD_MOSI, SD_MISO, -1);
@@ -83,30 +152,137 @@ public:
 #endif
 
         SPI.begin(SD_SCK, SD_MISO, SD_MOSI, -1);
-        if (!SD.begin(SD_CS, SPI, 4000000))
+        if (!SDCard.begin(SD_CS, SPI, SD_MAX_MHZ * 1000000UL))
         {
             Serial.println("❌ SD init failed!");
             return false;
         }
-        File f = SD.open(path);
+        Serial.printf("💾 SD mounted at %lu MHz\n", (unsigned long)(SDCard.clockHz() / 1000000));
+        return load(path);
+    }
+
+    // Read a config.json from the mounted SD card
+    bool load(const char *path)
+    {
+        File f = SDCard.open(path);
         if (!f)
         {
             Serial.printf("❌ Failed to open %s\n", path);
+            error = "open " + String(path) + " failed";
             return false;
         }
+        return load(f);
+    }
+
+    // Read a config.json held in memory (e.g. POST /api/config)
+    bool loadFromBuffer(uint8_t *data, size_t len)
+    {
+        return load(make_virtual_file(data, len));
+    }
 
-        DynamicJsonDocument doc(64 * 1024);
-        auto err = deserializeJson(doc, f);
+    bool load(File f)
+    {
+        // Unchanged JSON: take everything from the compiled cache
+        sourceSize = f.size();
+        sourceHash = hashFile(f);
+        if (loadCache())
+        {
+            f.close();
+            Serial.println("⚡ Config loaded from cache");
+            return true;
+        }
+
+        // Keep only the keys we read, WLED configs carry lots of unrelated
+        // sections. The document grows on the heap as needed.
+        JsonDocument filter;
+        filter["hw"]["led"]["total"] = true;
+        filter["hw"]["led"]["ins"][0] = true;
+        filter["hw"]["led"]["maxpwr"] = true;
+        filter["hw"]["led"]["ledma"] = true;
+        JsonObject panel = filter["hw"]["led"]["matrix"]["panels"].add<JsonObject>();
+        for (const char *key : {"x", "y", "w", "h", "b", "r", "v", "s"})
+            panel[key] = true;
+        filter["transform"] = true;
+        filter["sync"] = true;
+        filter["display"] = true;
+        filter["http"] = true;
+        filter["wifi"] = true;
+        filter["ap"] = true;
+
+        f.seek(0);
+        JsonDocument doc;
+        auto err = deserializeJson(doc, f, DeserializationOption::Filter(filter));
         f.close();
         if (err)
         {
             Serial.printf("❌ JSON parse error: %s\n", err.c_str());
+            error = err == DeserializationError::NoMemory ? String("config too large")
+                                                         : String("bad json: ") + err.c_str();
             return false;
         }
         parseDocument(doc);
+        ledMap.clear();
         return true;
     }
 
+    // True if these settings can drive a matrix, else sets error
+    bool validate()
+    {
+        if (!stripLen)
+            error = "hw.led.ins[0].len missing";
+        else if (panels.empty() || !matrixWidth || !matrixHeight)
+            error = "no panels";
+        else if (size_t(width) * height > MAX_MATRIX_PIXELS)
+            error = "matrix too large";
+        else if (ledType == LED_TYPE_APA102 && clockPin == 0xFF)
+            error = "APA102 needs a clock pin";
+        else
+        {
+            for (auto &p : panels)
+                if (!p.w || !p.h)
+                {
+                    error = "empty panel";
+                    return false;
+                }
+            return true;
+        }
+        return false;
+    }
+
+    // Settings that only take effect after a reboot
+    bool sameNetwork(const ConfigReader &o) const
+    {
+        return wifiSsid == o.wifiSsid && wifiPassword == o.wifiPassword &&
+               apSSID == o.apSSID && apPassword == o.apPassword &&
+               apChannel == o.apChannel && apHidden == o.apHidden;
+    }
+
+    // Write the compiled config next to the JSON; ledMap is the driver's
+    // flattened (x,y) → LED table for these settings
+    void saveCache(const std::vector<int32_t> &map)
+    {
+        BlobWriter b;
+        cacheFields(b);
+        uint16_t n = panels.size();
+        b.io(n);
+        for (auto &pc : panels)
+            b.io(pc);
+        for (int32_t led : map)
+            b.io(uint16_t(led < 0 ? 0xFFFF : led));
+
+        CacheHeader h = {CACHE_MAGIC, CACHE_VERSION, 0, sourceSize, sourceHash,
+                         uint32_t(b.buf.size()), fnv1a(b.buf.data(), b.buf.size())};
+        File f = SDCard.open(CONFIG_CACHE_PATH, FILE_WRITE);
+        if (!f)
+        {
+            Serial.println("⚠️ Writing config cache failed");
+            return;
+        }
+        f.write((const uint8_t *)&h, sizeof(h));
+        f.write(b.buf.data(), b.buf.size());
+        f.close();
+    }
+
     void beginWiFi()
     {
         if (wifiSsid.isEmpty())
@@ -134,6 +310,159 @@ public:
     }
 
 private:
+    static const uint32_t CACHE_MAGIC = 0x43434D4C; // "LMCC"
+    static const uint16_t CACHE_VERSION = 8;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t sourceSize, sourceHash; // config.json this was compiled from
+        uint32_t bodySize, bodyHash;
+    };
+
+    // Sequential (de)serializers for cacheFields(), one list of fields for both ways
+    struct BlobWriter
+    {
+        std::vector<uint8_t> buf;
+        template <class T>
+        void io(const T &v)
+        {
+            const uint8_t *p = (const uint8_t *)&v;
+            buf.insert(buf.end(), p, p + sizeof(T));
+        }
+        void io(const String &s)
+        {
+            uint16_t n = s.length();
+            io(n);
+            buf.insert(buf.end(), s.c_str(), s.c_str() + n);
+        }
+    };
+    struct BlobReader
+    {
+        const uint8_t *p, *end;
+        bool ok = true;
+        BlobReader(const std::vector<uint8_t> &buf) : p(buf.data()), end(buf.data() + buf.size()) {}
+        template <class T>
+        void io(T &v)
+        {
+            if (size_t(end - p) < sizeof(T))
+            {
+                ok = false;
+                return;
+            }
+            memcpy(&v, p, sizeof(T));
+            p += sizeof(T);
+        }
+        void io(String &s)
+        {
+            uint16_t n = 0;
+            io(n);
+            if (!ok || size_t(end - p) < n)
+            {
+                ok = false;
+                return;
+            }
+            s = String((const char *)p, n);
+            p += n;
+        }
+    };
+
+    uint32_t sourceSize = 0, sourceHash = 0;
+
+    template <class B>
+    void cacheFields(B &b)
+    {
+        b.io(totalLEDs);
+        b.io(startLED);
+        b.io(stripLen);
+        b.io(skipLEDs);
+        b.io(pin);
+        b.io(order);
+        b.io(ledType);
+        b.io(clockPin);
+        b.io(spiKHz);
+        b.io(maxPowerMa);
+        b.io(ledMa);
+        b.io(reverse);
+        b.io(matrixWidth);
+        b.io(matrixHeight);
+        b.io(rotate);
+        b.io(flipX);
+        b.io(flipY);
+        b.io(viewX);
+        b.io(viewY);
+        b.io(width);
+        b.io(height);
+        b.io(scaleMode);
+        b.io(prefetchFrames);
+        b.io(flashLoops);
+        b.io(crossfadeFps);
+        b.io(maxUploads);
+        b.io(jsonArenaKB);
+        b.io(syncRole);
+        b.io(syncPort);
+        b.io(wifiSsid);
+        b.io(wifiPassword);
+        b.io(apSSID);
+        b.io(apPassword);
+        b.io(apChannel);
+        b.io(apHidden);
+    }
+
+    static uint32_t hashFile(File &f)
+    {
+        uint8_t chunk[512];
+        uint32_t h = 2166136261u;
+        size_t n;
+        while ((n = f.read(chunk, sizeof(chunk))) > 0)
+            h = fnv1a(chunk, n, h);
+        return h;
+    }
+
+    // Settings, panels and LED map from CONFIG_CACHE_PATH if it was compiled
+    // from the current JSON (sourceSize/sourceHash) and is intact
+    bool loadCache()
+    {
+        File f = SDCard.open(CONFIG_CACHE_PATH, FILE_READ);
+        if (!f)
+            return false;
+        CacheHeader h;
+        bool ok = f.read((uint8_t *)&h, sizeof(h)) == sizeof(h) &&
+                  h.magic == CACHE_MAGIC && h.version == CACHE_VERSION &&
+                  h.sourceSize == sourceSize && h.sourceHash == sourceHash &&
+                  h.bodySize < 256 * 1024;
+        std::vector<uint8_t> body;
+        if (ok)
+        {
+            body.resize(h.bodySize);
+            ok = f.read(body.data(), body.size()) == body.size() &&
+                 fnv1a(body.data(), body.size()) == h.bodyHash;
+        }
+        f.close();
+        if (!ok)
+            return false;
+
+        BlobReader b(body);
+        cacheFields(b);
+        uint16_t n = 0;
+        b.io(n);
+        panels.resize(n);
+        for (auto &pc : panels)
+            b.io(pc);
+        ledMap.resize(size_t(width) * height);
+        for (auto &led : ledMap)
+        {
+            uint16_t v = 0xFFFF;
+            b.io(v);
+            led = v == 0xFFFF ? -1 : v;
+        }
+        if (!b.ok)
+            ledMap.clear();
+        return b.ok;
+    }
+
     void startSoftAP()
     {
         WiFi.mode(WIFI_MODE_AP);
@@ -176,15 +505,21 @@ private:
         stripLen = ins0["len"].as<uint16_t>();
         skipLEDs = ins0["skip"].as<uint16_t>();
         pin = ins0["pin"][0].as<uint8_t>();
+        clockPin = ins0["pin"].size() > 1 ? ins0["pin"][1].as<uint8_t>() : 0xFF;
         order = ins0["order"].as<uint8_t>();
+        ledType = ins0["type"] | 22;
+        spiKHz = ins0["freq"] | 10000;
         reverse = ins0["rev"].as<bool>();
+        // per output like WLED's bus settings, or the global hw.led values
+        maxPowerMa = ins0["maxpwr"] | (hwLed["maxpwr"] | 0);
+        ledMa = constrain(ins0["ledma"] | (hwLed["ledma"] | 55), 1, 255);
 
-        Serial.printf("LEDs: total=%d, start=%d, len=%d, skip=%d, pin=%d, order=%d, reverse=%d\n",
-                      totalLEDs, startLED, stripLen, skipLEDs, pin, order, reverse);
+        Serial.printf("LEDs: total=%d, start=%d, len=%d, skip=%d, pin=%d, order=%d, type=%d, reverse=%d\n",
+                      totalLEDs, startLED, stripLen, skipLEDs, pin, order, ledType, reverse);
 
         // — Parse panels using WLED flags —
         auto panelsArr = hwLed["matrix"]["panels"].as<JsonArray>();
-        width = height = 0;
+        matrixWidth = matrixHeight = 0;
         panels.clear();
         for (auto p : panelsArr)
         {
@@ -198,11 +533,40 @@ private:
             pc.vertical = p["v"].as<bool>();
             pc.serpentine = p["s"].as<bool>();
             panels.push_back(pc);
-            width = max<uint16_t>(width, pc.x + pc.w);
-            height = max<uint16_t>(height, pc.y + pc.h);
+            matrixWidth = max<uint16_t>(matrixWidth, pc.x + pc.w);
+            matrixHeight = max<uint16_t>(matrixHeight, pc.y + pc.h);
         }
 
-        Serial.printf("Matrix: width=%d, height=%d, panels=%zu\n", width, height, panels.size());
+        // — Parse transform: the content size defaults to the rotated matrix —
+        auto tf = doc["transform"].as<JsonObject>();
+        rotate = ((tf["rotate"] | 0) % 360 + 360) % 360 / 90 * 90;
+        flipX = tf["flipX"].as<bool>();
+        flipY = tf["flipY"].as<bool>();
+        viewX = tf["x"] | 0;
+        viewY = tf["y"] | 0;
+        bool quarter = rotate == 90 || rotate == 270;
+        width = tf["w"] | 0;
+        height = tf["h"] | 0;
+        if (!width)
+            width = quarter ? matrixHeight : matrixWidth;
+        if (!height)
+            height = quarter ? matrixWidth : matrixHeight;
+
+        Serial.printf("Matrix: width=%d, height=%d, panels=%zu, content %dx%d, rotate=%u%s%s\n",
+                      matrixWidth, matrixHeight, panels.size(), width, height, rotate,
+                      flipX ? ", flipX" : "", flipY ? ", flipY" : "");
+
+        // — Parse display section —
+        String scale = doc["display"]["scale"] | "nearest";
+        scaleMode = scale == "area" ? SCALE_AREA : SCALE_NEAREST;
+        prefetchFrames = min<uint8_t>(doc["display"]["prefetch"] | 3, 16);
+        flashLoops = doc["display"]["flashLoops"] | 0;
+        crossfadeFps = constrain(doc["display"]["crossfade"] | 0, 0, 100);
+        maxUploads = constrain(doc["http"]["maxUploads"] | 2, 1, 8);
+        jsonArenaKB = min(doc["http"]["jsonArena"] | 8, 64);
+        String role = doc["sync"]["role"] | "off";
+        syncRole = role == "leader" ? SYNC_LEADER : role == "follower" ? SYNC_FOLLOWER : SYNC_OFF;
+        syncPort = doc["sync"]["port"] | 4210;
 
         // — Parse Wi-Fi section —
         auto wifi = doc["wifi"].as<JsonObject>();
@@ -212,13 +576,13 @@ private:
         Serial.printf("Wi-Fi: SSID=%s\n", wifiSsid.c_str());
 
         auto ap = doc["ap"].as<JsonObject>();
-        if (ap.containsKey("ssid"))
+        if (!ap["ssid"].isNull())
             apSSID = ap["ssid"].as<const char *>();
-        if (ap.containsKey("password"))
+        if (!ap["password"].isNull())
             apPassword = ap["password"].as<const char *>();
-        if (ap.containsKey("chan"))
+        if (!ap["chan"].isNull())
             apChannel = ap["chan"].as<uint8_t>();
-        if (ap.containsKey("hide"))
+        if (!ap["hide"].isNull())
             apHidden = ap["hide"].as<bool>();
 
         Serial.printf("AP: SSID=%s, Channel=%d, Hidden=%d\n", apSSID.c_str(), apChannel, apHidden);
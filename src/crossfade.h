@@ -0,0 +1,103 @@
+// crossfade.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <vector>
+#include "matrix_driver.h"
+
+// ——— Blended output frames between two chain frames ———
+// Keeps the last two chain frames; loop() hands in each new one (take() /
+// decode()) when it is due and calls show() with the position in between
+// as often as the output rate allows, so a 12 fps chain plays at e.g.
+// 50 fps without extra frames on SD. The blend itself runs in
+// MatrixDriver::showBlend() straight into the framebuffer.
+class Crossfader
+{
+public:
+    struct Stats
+    {
+        uint32_t shown = 0;        // blended output frames
+        uint32_t frameMicros = 0;  // last one, blend + transfer
+        uint32_t late = 0;         // output frames that took longer than their interval
+    } stats;
+
+    Crossfader() : lock(xSemaphoreCreateMutex()) {}
+
+    // Frame size and output rate (0 = off, the buffers are freed)
+    void resize(size_t bytes, uint8_t outFps)
+    {
+        LockGuard g(lock);
+        fps = outFps;
+        frames = 0;
+        if (!fps)
+            bytes = 0;
+        from.assign(bytes, 0);
+        to.assign(bytes, 0);
+        from.shrink_to_fit();
+        to.shrink_to_fit();
+        stats = Stats();
+    }
+
+    bool enabled() const { return fps; }
+    uint8_t outputFps() const { return fps; }
+    uint16_t interval() const { return fps ? 1000 / fps : 0; } // ms between output frames
+
+    // Forget the frames of the previous chain; the next one taken is shown as is
+    void restart() { frames = 0; }
+    bool primed() const { return frames; }
+
+    // Newest chain frame from a finished framebuffer (prefetch ring, flash tier)
+    bool take(const uint8_t *fb, size_t bytes)
+    {
+        LockGuard g(lock);
+        if (bytes != to.size())
+            return false;
+        from.swap(to);
+        memcpy(to.data(), fb, bytes);
+        settle();
+        return true;
+    }
+
+    // Newest chain frame decoded from an image file
+    bool decode(MatrixDriver &drv, const char *path)
+    {
+        LockGuard g(lock);
+        if (!drv.decodeInto(path, from.data(), from.size()))
+            return false;
+        from.swap(to);
+        settle();
+        return true;
+    }
+
+    // Show the previous frame faded towards the newest by t / 256
+    bool show(MatrixDriver &drv, uint16_t t)
+    {
+        LockGuard g(lock);
+        if (!frames)
+            return false;
+        uint32_t t0 = micros();
+        bool ok = drv.showBlend(from.data(), to.data(), to.size(), t);
+        stats.frameMicros = micros() - t0;
+        stats.shown++;
+        if (stats.frameMicros > interval() * 1000u)
+            stats.late++;
+        return ok;
+    }
+
+private:
+    SemaphoreHandle_t lock;
+    std::vector<uint8_t> from, to; // previous and newest chain frame
+    uint8_t fps = 0;
+    volatile uint8_t frames = 0; // taken since restart(), up to 2
+
+    // The first frame after restart() has nothing to fade from
+    void settle()
+    {
+        if (!frames)
+            memcpy(from.data(), to.data(), to.size());
+        if (frames < 2)
+            frames++;
+    }
+};
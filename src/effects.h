@@ -0,0 +1,393 @@
+// effects.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <math.h>
+#include <vector>
+#include "matrix_driver.h"
+
+// ——— Procedural effects computed per frame on the device ———
+// All kernels are integer / 8.8 fixed point and fill the framebuffer row
+// by row. Anything that only depends on x or only on y (sine terms, noise
+// lattice columns, gradient steps) is computed once per frame into a small
+// table, so the per-pixel work is a few table lookups and adds. Tables
+// that don't change over time (spiral order, palettes) are built by set().
+enum EffectId : uint8_t
+{
+    EFFECT_PLASMA,
+    EFFECT_SPIRAL,   // hue along the path of api-tests/spiral_generator.py, cycling
+    EFFECT_NOISE,    // animated value noise
+    EFFECT_FIRE,
+    EFFECT_GRADIENT, // two colors, any angle, moving
+    EFFECT_CYCLE,    // rainbow across x (or one color for spread 0), cycling
+    EFFECT_COUNT,
+};
+
+static const char *const EFFECT_NAMES[EFFECT_COUNT] = {"plasma", "spiral", "noise", "fire", "gradient", "cycle"};
+
+class EffectEngine
+{
+public:
+    struct Params
+    {
+        uint16_t speed = 64;  // phase steps (1/256 of a cycle) per second
+        uint8_t scale = 32;   // spatial frequency / cell size, per effect
+        uint8_t color[3] = {255, 0, 0};
+        uint8_t color2[3] = {0, 0, 255};
+        int16_t angle = 0;    // gradient direction in degrees, 0 = left → right
+    };
+
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint32_t renderMicros = 0; // last frame
+        float benchFps = 0;        // kernel only, measured by start()
+    } stats;
+
+    EffectEngine() : lock(xSemaphoreCreateMutex()) {}
+
+    // Look up an effect by name, EFFECT_COUNT if unknown
+    static EffectId byName(const char *name)
+    {
+        for (uint8_t i = 0; i < EFFECT_COUNT; i++)
+            if (!strcmp(name, EFFECT_NAMES[i]))
+                return EffectId(i);
+        return EFFECT_COUNT;
+    }
+
+    // Prepare effect `id` for a w x h matrix. A running engine switches to
+    // it right away, a stopped one from start() on.
+    bool set(EffectId id, const Params &p, uint16_t w, uint16_t h)
+    {
+        LockGuard g(lock);
+        if (id >= EFFECT_COUNT || !w || !h)
+            return false;
+        effect = id;
+        params = p;
+        prepare(w, h);
+        started = millis();
+        ready = true;
+        return true;
+    }
+
+    // loop(): measure the render rate of the effect prepared by set(), then
+    // show it. Measuring here keeps the benchmark off the web task, where it
+    // held the lock and stalled show() of a running effect.
+    void start()
+    {
+        LockGuard g(lock);
+        if (!ready)
+            return;
+        benchmark();
+        started = millis();
+        running = true;
+    }
+
+    // Matrix size changed: rebuild the tables for the current effect
+    void resize(uint16_t w, uint16_t h)
+    {
+        LockGuard g(lock);
+        if (ready)
+            prepare(w, h);
+    }
+
+    void stop()
+    {
+        LockGuard g(lock);
+        running = false;
+    }
+
+    bool active() const { return running; }
+    const char *name() const { return EFFECT_NAMES[effect]; }
+
+    // Render the frame for `now` (millis) and show it
+    bool show(MatrixDriver &drv, uint32_t now)
+    {
+        LockGuard g(lock);
+        if (!running)
+            return false;
+        uint32_t t0 = micros();
+        render(uint64_t(now - started) * params.speed * 256 / 1000);
+        stats.frames++;
+        stats.renderMicros = micros() - t0;
+        return drv.showFrame(fb.data(), fb.size());
+    }
+
+private:
+    SemaphoreHandle_t lock;
+    EffectId effect = EFFECT_PLASMA;
+    Params params;
+    uint16_t width = 0, height = 0;
+    uint32_t started = 0;
+    volatile bool running = false;
+    bool ready = false; // prepared, start() can show it
+    uint32_t rng = 0x9E3779B9;
+
+    std::vector<uint8_t> fb;      // width x height RGB888
+    std::vector<uint8_t> colTab;  // per-frame x terms
+    std::vector<uint8_t> rowTab;  // per-frame y terms (also x + y for plasma)
+    std::vector<uint8_t> pixTab;  // static per-pixel values: spiral hue, fire heat
+    uint8_t sin8[256];            // 128 + 127 sin(2πi/256)
+    uint8_t perm[256];            // noise lattice hash
+    uint8_t smooth[256];          // smoothstep, 8 bit
+    uint8_t palette[256 * 3];     // hue wheel, fire colors or the gradient
+
+    // ——— Table setup, once per set() / resize() ———
+    void prepare(uint16_t w, uint16_t h)
+    {
+        width = w;
+        height = h;
+        fb.assign(size_t(w) * h * 3, 0);
+        colTab.assign(w, 0);
+        rowTab.assign(size_t(w) + h, 0);
+        for (int i = 0; i < 256; i++)
+        {
+            sin8[i] = 128 + int(lroundf(127 * sinf(i * 2 * PI / 256)));
+            smooth[i] = (i * i * (768 - 2 * i)) >> 16; // 3t² - 2t³
+            perm[i] = i;
+        }
+        for (int i = 255; i > 0; i--)
+            std::swap(perm[i], perm[random8() % (i + 1)]);
+
+        switch (effect)
+        {
+        case EFFECT_FIRE:
+            // black → red → yellow → white
+            for (int i = 0; i < 256; i++)
+            {
+                uint8_t *c = palette + i * 3;
+                c[0] = std::min(255, i * 3);
+                c[1] = i < 85 ? 0 : std::min(255, (i - 85) * 3);
+                c[2] = i < 170 ? 0 : (i - 170) * 3;
+            }
+            pixTab.assign(size_t(w) * h, 0);
+            break;
+        case EFFECT_GRADIENT:
+            for (int i = 0; i < 256; i++)
+                for (int c = 0; c < 3; c++)
+                    palette[i * 3 + c] = (params.color[c] * (255 - i) + params.color2[c] * i) / 255;
+            pixTab.clear();
+            break;
+        case EFFECT_SPIRAL:
+            hueWheel();
+            buildSpiral();
+            break;
+        default:
+            hueWheel();
+            pixTab.clear();
+            break;
+        }
+    }
+
+    // Full-saturation rainbow, 6 linear segments
+    void hueWheel()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t seg = i * 6 / 256, f = (i * 6) & 255; // segment and position in it
+            uint8_t up = f, down = 255 - f;
+            uint8_t rgb[6][3] = {{255, up, 0}, {down, 255, 0}, {0, 255, up}, {0, down, 255}, {up, 0, 255}, {255, 0, down}};
+            memcpy(palette + i * 3, rgb[seg], 3);
+        }
+    }
+
+    // Hue by position on the inward spiral from the top-left corner
+    void buildSpiral()
+    {
+        pixTab.assign(size_t(width) * height, 0);
+        uint32_t total = uint32_t(width) * height, index = 0;
+        int top = 0, bottom = height - 1, left = 0, right = width - 1;
+        auto put = [&](int x, int y)
+        { pixTab[size_t(y) * width + x] = index++ * 256 / total; };
+        while (left <= right && top <= bottom)
+        {
+            for (int x = left; x <= right; x++)
+                put(x, top);
+            top++;
+            for (int y = top; y <= bottom; y++)
+                put(right, y);
+            right--;
+            if (top <= bottom)
+            {
+                for (int x = right; x >= left; x--)
+                    put(x, bottom);
+                bottom--;
+            }
+            if (left <= right)
+            {
+                for (int y = bottom; y >= top; y--)
+                    put(left, y);
+                left++;
+            }
+        }
+    }
+
+    uint8_t random8()
+    {
+        // xorshift32
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng >> 24;
+    }
+
+    // Render 50 frames without showing them, kernel speed for /api/effect
+    void benchmark()
+    {
+        const int FRAMES = 50;
+        uint32_t t0 = micros();
+        for (int i = 0; i < FRAMES; i++)
+            render(uint32_t(i) * 1024);
+        uint32_t dt = micros() - t0;
+        stats.benchFps = dt ? FRAMES * 1e6f / dt : 0;
+        if (effect == EFFECT_FIRE)
+            std::fill(pixTab.begin(), pixTab.end(), 0);
+    }
+
+    // ——— Kernels; phase is in 1/256 of a cycle (8.8 fixed point) ———
+    void render(uint32_t phase)
+    {
+        switch (effect)
+        {
+        case EFFECT_PLASMA:
+            plasma(phase);
+            break;
+        case EFFECT_SPIRAL:
+            indexed(phase >> 8);
+            break;
+        case EFFECT_NOISE:
+            noise(phase);
+            break;
+        case EFFECT_FIRE:
+            fire();
+            break;
+        case EFFECT_GRADIENT:
+            gradient(phase);
+            break;
+        case EFFECT_CYCLE:
+            cycle(phase >> 8);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Pixel = palette[pixTab + shift]
+    void indexed(uint8_t shift)
+    {
+        const uint8_t *v = pixTab.data();
+        uint8_t *p = fb.data();
+        for (size_t i = 0, n = pixTab.size(); i < n; i++, p += 3)
+            memcpy(p, palette + uint8_t(v[i] + shift) * 3, 3);
+    }
+
+    // Sum of sines in x, y and x + y, each drifting at its own rate
+    void plasma(uint32_t phase)
+    {
+        uint8_t t = phase >> 8, k = params.scale >> 3 | 1;
+        for (int x = 0; x < width; x++)
+            colTab[x] = sin8[uint8_t(x * k + t)];
+        for (int i = 0; i < width + height - 1; i++)
+            rowTab[i] = sin8[uint8_t(i * k / 2 + t * 3 / 2)];
+        uint8_t *p = fb.data();
+        for (int y = 0; y < height; y++)
+        {
+            uint8_t sy = sin8[uint8_t(y * k - t * 2)];
+            const uint8_t *diag = &rowTab[y];
+            for (int x = 0; x < width; x++, p += 3)
+            {
+                uint8_t hue = (colTab[x] + sy + diag[x] + t) >> 1;
+                memcpy(p, palette + hue * 3, 3);
+            }
+        }
+    }
+
+    // Bilinear value noise, lattice cells of `scale` / 4 pixels, scrolling
+    void noise(uint32_t phase)
+    {
+        uint32_t step = 1024 / std::max<uint8_t>(params.scale, 4); // 8.8 lattice units per pixel
+        // per column: lattice cell and smoothed fraction (rowTab is free here)
+        std::vector<uint8_t> &cell = colTab, &frac = rowTab;
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t u = x * step + phase / 2;
+            cell[x] = u >> 8;
+            frac[x] = smooth[u & 255];
+        }
+        uint8_t *p = fb.data();
+        for (int y = 0; y < height; y++)
+        {
+            uint32_t v = y * step + phase / 3;
+            uint8_t cy = v >> 8, fy = smooth[v & 255];
+            // lattice value at (cx, cy) is perm[perm[cy] + cx]
+            uint8_t h0 = perm[cy], h1 = perm[uint8_t(cy + 1)];
+            for (int x = 0; x < width; x++, p += 3)
+            {
+                uint8_t cx = cell[x], fx = frac[x];
+                uint8_t a = perm[uint8_t(h0 + cx)], b = perm[uint8_t(h0 + cx + 1)];
+                uint8_t c = perm[uint8_t(h1 + cx)], d = perm[uint8_t(h1 + cx + 1)];
+                int top = a + (((b - a) * fx) >> 8);
+                int bot = c + (((d - c) * fx) >> 8);
+                uint8_t val = top + (((bot - top) * fy) >> 8);
+                memcpy(p, palette + uint8_t(val + (phase >> 10)) * 3, 3);
+            }
+        }
+    }
+
+    // Heat rises from a random bottom row, averaging and cooling on the way
+    void fire()
+    {
+        uint8_t *heat = pixTab.data();
+        uint8_t cool = params.scale / 8 + 1;
+        uint8_t *bottom = heat + size_t(height - 1) * width;
+        for (int x = 0; x < width; x++)
+            bottom[x] = random8() | 0x80;
+        for (int y = 0; y < height - 1; y++)
+        {
+            const uint8_t *below = heat + size_t(y + 1) * width;
+            const uint8_t *below2 = heat + size_t(std::min(y + 2, height - 1)) * width;
+            uint8_t *row = heat + size_t(y) * width;
+            for (int x = 0; x < width; x++)
+            {
+                int l = x ? x - 1 : 0, r = x + 1 < width ? x + 1 : x;
+                int v = (below[l] + below[x] + below[r] + below2[x]) >> 2;
+                int c = random8() % cool;
+                row[x] = v > c ? v - c : 0;
+            }
+        }
+        const uint8_t *v = heat;
+        uint8_t *p = fb.data();
+        for (size_t i = 0, n = pixTab.size(); i < n; i++, p += 3)
+            memcpy(p, palette + v[i] * 3, 3);
+    }
+
+    // color → color2 → color along `angle`, one period every 2048 / scale px
+    void gradient(uint32_t phase)
+    {
+        float a = params.angle * PI / 180;
+        int32_t dx = lroundf(cosf(a) * params.scale * 32), dy = lroundf(sinf(a) * params.scale * 32);
+        uint8_t *p = fb.data();
+        for (int y = 0; y < height; y++)
+        {
+            int32_t pos = y * dy + int32_t(phase);
+            for (int x = 0; x < width; x++, p += 3, pos += dx)
+            {
+                uint16_t tri = (pos >> 7) & 511; // triangle wave 0..255..0
+                memcpy(p, palette + (tri < 256 ? tri : 511 - tri) * 3, 3);
+            }
+        }
+    }
+
+    // Rainbow across x, `scale` hue steps per column; one row, copied down
+    void cycle(uint8_t shift)
+    {
+        uint8_t *row = fb.data();
+        for (int x = 0; x < width; x++)
+            memcpy(row + x * 3, palette + uint8_t(shift + x * params.scale / 8) * 3, 3);
+        size_t stride = size_t(width) * 3;
+        for (int y = 1; y < height; y++)
+            memcpy(row + y * stride, row, stride);
+    }
+};
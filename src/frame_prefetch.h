@@ -0,0 +1,207 @@
+// frame_prefetch.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <vector>
+#include "matrix_driver.h"
+#include "frame_store.h"
+#include "heap_stats.h"
+
+// ——— Reads the active chain ahead into a ring of decoded framebuffers ———
+// A producer task decodes the next frames from SD while loop() only copies
+// finished frames out of the ring, so a slow sector delays the producer
+// instead of the display. Single producer, single consumer: slots
+// [head, head + count) are ready, the producer only writes slot head + count.
+// Frames held by the flash tier are copied from there instead of decoded.
+class FramePrefetcher
+{
+public:
+    struct Stats
+    {
+        uint32_t produced = 0;  // frames decoded into the ring
+        uint32_t consumed = 0;  // frames taken out by the display
+        uint32_t underruns = 0; // frames that were due while the ring was empty
+        uint32_t failed = 0;    // frames that could not be decoded (skipped)
+        uint8_t minDepth = 0;   // lowest occupancy seen at consume time
+        uint32_t decodeMicros = 0;
+        uint32_t frameAllocs = 0; // heap allocations for the last frame, 0 in steady state
+    } stats;
+
+    FramePrefetcher(MatrixDriver &d, uint8_t slots, FlashFrameStore *flash = nullptr)
+        : drv(d), flash(flash), slots(slots), frameBytes(d.frame.size()),
+          slotFrame(slots, 0), lock(xSemaphoreCreateMutex()), fill(xSemaphoreCreateMutex())
+    {
+        ring.assign(size_t(slots) * frameBytes, 0);
+        xTaskCreate(taskEntry, "prefetch", 8192, this, 1, &task);
+        heapTrackTask(HEAP_TASK_PREFETCH, task);
+    }
+
+    // Play `chain` starting at index `first`; drops anything read ahead for
+    // the previous chain
+    void start(const String *chain, uint8_t len, uint8_t first)
+    {
+        {
+            LockGuard g(lock);
+            names.assign(chain, chain + len);
+            next = len ? first % len : 0;
+            head = count = 0;
+            generation++;
+            running = len > 0 && slots > 0;
+            starving = false;
+            stats = Stats();
+            stats.minDepth = slots;
+        }
+        xTaskNotifyGive(task);
+    }
+
+    void stop()
+    {
+        LockGuard g(lock);
+        running = false;
+        head = count = 0;
+        generation++;
+    }
+
+    // Follow MatrixDriver::reconfigure(): new frame size and slot count.
+    // Drops the ring, start() again afterwards.
+    void resize(uint8_t newSlots)
+    {
+        LockGuard f(fill); // producer is not writing into the ring
+        LockGuard g(lock);
+        running = false;
+        head = count = 0;
+        generation++;
+        slots = newSlots;
+        frameBytes = drv.frame.size();
+        ring.assign(size_t(slots) * frameBytes, 0);
+        slotFrame.assign(slots, 0);
+    }
+
+    bool active() const { return running; }
+    uint8_t capacity() const { return slots; }
+    uint8_t depth() const { return count; }
+    size_t frameSize() const { return frameBytes; }
+
+    // Oldest ready frame and its chain index, nullptr if the ring is empty
+    const uint8_t *front(uint8_t &index)
+    {
+        LockGuard g(lock);
+        if (!count)
+        {
+            // count each late frame once, not every poll
+            if (!starving)
+                stats.underruns++;
+            starving = true;
+            return nullptr;
+        }
+        starving = false;
+        if (count < stats.minDepth)
+            stats.minDepth = count;
+        index = slotFrame[head];
+        return &ring[size_t(head) * frameBytes];
+    }
+
+    // Release the frame returned by front()
+    void pop()
+    {
+        {
+            LockGuard g(lock);
+            if (!count)
+                return;
+            head = (head + 1) % slots;
+            count--;
+            stats.consumed++;
+        }
+        xTaskNotifyGive(task);
+    }
+
+private:
+    MatrixDriver &drv;
+    FlashFrameStore *flash;
+    uint8_t slots;
+    size_t frameBytes;
+    std::vector<uint8_t> ring;      // slots * frameBytes
+    std::vector<uint8_t> slotFrame; // chain index held by each slot
+    std::vector<String> names;      // private copy of the chain
+    SemaphoreHandle_t lock;
+    SemaphoreHandle_t fill; // held by the producer while it writes a slot, taken before lock
+    TaskHandle_t task = nullptr;
+    uint32_t generation = 0;        // bumped on start/stop, stale decodes are dropped
+    uint8_t next = 0;               // chain index to decode next
+    volatile uint8_t head = 0, count = 0;
+    volatile bool running = false;
+    bool starving = false;
+
+    static void taskEntry(void *arg) { static_cast<FramePrefetcher *>(arg)->run(); }
+
+    void run()
+    {
+        for (;;)
+        {
+            bool idle;
+            {
+                LockGuard f(fill);
+                idle = !produce();
+            }
+            // full or stopped: wait for pop() / start()
+            if (idle)
+                ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+    }
+
+    // Fill the next free slot, false if there is none. Called with fill held.
+    bool produce()
+    {
+        char path[IMAGE_PATH_MAX];
+        uint8_t index, slot;
+        uint32_t gen;
+        bool ok;
+        {
+            LockGuard g(lock);
+            if (!running || count >= slots)
+                return false;
+            index = next;
+            slot = (head + count) % slots;
+            gen = generation;
+            ok = imagePath(path, names[index].c_str());
+        }
+        const char *name = path + sizeof(IMAGES_DIR) - 1;
+
+        uint32_t t0 = micros();
+        uint32_t a0 = heapTaskAllocCount(HEAP_TASK_PREFETCH);
+        uint8_t *dst = &ring[size_t(slot) * frameBytes];
+        {
+            FlashFrameStore::Pin cached(flash, name);
+            if (cached)
+                memcpy(dst, cached.data(), frameBytes);
+            else if (ok)
+                ok = drv.decodeInto(path, dst, frameBytes);
+        }
+        uint32_t dt = micros() - t0;
+        uint32_t allocs = heapTaskAllocCount(HEAP_TASK_PREFETCH) - a0;
+
+        {
+            LockGuard g(lock);
+            if (gen != generation)
+                return true;
+            next = (index + 1) % names.size();
+            if (ok)
+            {
+                slotFrame[slot] = index;
+                count++;
+                stats.produced++;
+                stats.decodeMicros = dt;
+                stats.frameAllocs = allocs;
+                return true;
+            }
+            stats.failed++;
+        }
+        // missing / broken frame is skipped; don't spin on a chain of them
+        Serial.printf("❌ Prefetch %s failed\n", path);
+        vTaskDelay(1);
+        return true;
+    }
+};
@@ -0,0 +1,328 @@
+// frame_store.h
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <vector>
+#include "matrix_driver.h"
+
+// ——— Flash tier for hot frames ———
+// One chain is mirrored into the "frames" data partition as finished
+// framebuffers (already scaled, RGB888) and read back through a memory
+// mapping, so playing it needs neither the SD card nor a decode.
+//
+// Partition layout:
+//   0x0000  header + one name per frame, in chain order (DIR_BYTES)
+//   DIR_BYTES + i * stride  framebuffer of entry i
+// The header is written last, so an interrupted mirror leaves no valid
+// cache behind.
+class FlashFrameStore
+{
+public:
+    static const uint32_t MAGIC = 0x53464D4C; // "LMFS"
+    static const uint16_t VERSION = 1;
+    static const uint8_t NAME_LEN = 64;
+    static const uint32_t DIR_BYTES = 2 * SPI_FLASH_SEC_SIZE;
+
+    struct Stats
+    {
+        uint32_t hits = 0;     // frames served from flash
+        uint32_t misses = 0;   // lookups that fell back to SD
+        uint32_t mirrors = 0;  // chains written to flash
+        uint32_t mirrorFailed = 0;
+        uint32_t mirrorMillis = 0;
+    } stats;
+
+    FlashFrameStore(MatrixDriver &d)
+        : drv(d), frameBytes(d.frame.size()), stride((d.frame.size() + 3) & ~size_t(3)),
+          lock(xSemaphoreCreateMutex()) {}
+
+    // Map the partition and load its directory. False if there is no
+    // "frames" partition (old partition table) or it can't be mapped.
+    bool begin()
+    {
+        part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "frames");
+        if (!part)
+        {
+            Serial.println("⚠️ No frames partition, flash tier disabled");
+            return false;
+        }
+        const void *p;
+        esp_err_t err = esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &p, &mapHandle);
+        if (err != ESP_OK)
+        {
+            Serial.printf("⚠️ Mapping frames partition failed: %s\n", esp_err_to_name(err));
+            part = nullptr;
+            return false;
+        }
+        base = (const uint8_t *)p;
+
+        const Header *h = (const Header *)base;
+        if (h->magic == MAGIC && h->version == VERSION && h->frameBytes == frameBytes &&
+            h->width == drv.cfg.width && h->height == drv.cfg.height && h->count <= capacity())
+        {
+            const char *entry = (const char *)(base + sizeof(Header));
+            for (uint16_t i = 0; i < h->count; i++, entry += NAME_LEN)
+                names.push_back(String(entry, strnlen(entry, NAME_LEN)));
+            chainMillis = h->frameMs;
+        }
+        Serial.printf("Flash tier: %u of %u frames cached\n", unsigned(names.size()), capacity());
+        return true;
+    }
+
+    // Follow MatrixDriver::reconfigure(): frames cached for another matrix
+    // size are unusable until the next mirror()
+    void resize()
+    {
+        LockGuard g(lock);
+        if (frameBytes == drv.frame.size())
+            return;
+        frameBytes = drv.frame.size();
+        stride = (frameBytes + 3) & ~size_t(3);
+        names.clear();
+    }
+
+    bool ready() const { return base; }
+    bool busy() const { return mirroring; }
+    uint16_t capacity() const { return part ? (part->size - DIR_BYTES) / stride : 0; }
+    uint16_t size() const { return names.size(); }
+    size_t frameSize() const { return frameBytes; }
+
+    // Framebuffer of a cached image while the Pin lives, empty on a miss.
+    // A mirror() waits for all pins to be released before it erases.
+    class Pin
+    {
+    public:
+        Pin(FlashFrameStore *store, const char *name)
+            : store(store), p(store ? store->acquire(name) : nullptr) {}
+        ~Pin()
+        {
+            if (p)
+                store->release();
+        }
+        const uint8_t *data() const { return p; }
+        explicit operator bool() const { return p; }
+
+    private:
+        FlashFrameStore *store;
+        const uint8_t *p;
+        Pin(const Pin &) = delete;
+        Pin &operator=(const Pin &) = delete;
+    };
+
+    // Cached, without counting a hit or miss (chain checks)
+    bool contains(const char *name)
+    {
+        LockGuard g(lock);
+        return indexOf(name) >= 0;
+    }
+
+    // Every frame of the chain is in flash
+    bool holdsAll(const String *chain, uint8_t len)
+    {
+        LockGuard g(lock);
+        for (uint8_t i = 0; i < len; i++)
+            if (indexOf(chain[i].c_str()) < 0)
+                return false;
+        return len > 0;
+    }
+
+    // Chain mirrored at the last boot / mirror(), for playing without SD
+    uint8_t cachedChain(String *chain, uint8_t max, uint16_t &frameMs)
+    {
+        LockGuard g(lock);
+        uint8_t n = min<size_t>(names.size(), max);
+        for (uint8_t i = 0; i < n; i++)
+            chain[i] = names[i];
+        frameMs = chainMillis;
+        return n;
+    }
+
+    // The image was overwritten on SD: drop its cached copy. Zeroing the
+    // first name byte needs no erase, so this survives a reboot.
+    void forget(const char *name)
+    {
+        LockGuard g(lock);
+        // a running mirror may already have read the old file, drop the
+        // name again when it is done
+        if (mirroring)
+            forgotten.push_back(name);
+        dropEntries(name);
+    }
+
+    // Start copying a chain into flash in the background; replaces whatever
+    // was cached. No-op if that chain is already there.
+    bool mirror(const String *chain, uint8_t len, uint16_t frameMs)
+    {
+        if (!base || mirroring || !len)
+            return false;
+        if (len > capacity() || len > (DIR_BYTES - sizeof(Header)) / NAME_LEN)
+        {
+            Serial.printf("⚠️ Chain of %u frames does not fit the flash tier\n", len);
+            return false;
+        }
+        for (uint8_t i = 0; i < len; i++)
+            if (chain[i].length() >= NAME_LEN)
+                return false;
+        {
+            LockGuard g(lock);
+            if (frameMs == chainMillis && names.size() == len &&
+                std::equal(names.begin(), names.end(), chain))
+                return true;
+            forgotten.clear();
+        }
+        pending.assign(chain, chain + len);
+        pendingMillis = frameMs;
+        mirroring = true;
+        if (xTaskCreate(mirrorEntry, "flashmirror", 8192, this, 1, nullptr) != pdPASS)
+        {
+            mirroring = false;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t count;
+        uint16_t width, height;
+        uint16_t frameMs;
+        uint16_t reserved;
+        uint32_t frameBytes;
+    };
+
+    MatrixDriver &drv;
+    size_t frameBytes, stride;
+    SemaphoreHandle_t lock;
+    const esp_partition_t *part = nullptr;
+    spi_flash_mmap_handle_t mapHandle;
+    const uint8_t *base = nullptr;
+    std::vector<String> names; // entry i ↔ frame i, empty = forgotten
+    uint16_t chainMillis = 0;
+    std::vector<String> pending;
+    std::vector<String> forgotten; // forget() calls during a mirror
+    uint16_t pendingMillis = 0;
+    volatile bool mirroring = false;
+    uint16_t readers = 0; // live Pins
+
+    int indexOf(const char *name) const
+    {
+        for (size_t i = 0; i < names.size(); i++)
+            if (names[i] == name)
+                return i;
+        return -1;
+    }
+
+    const uint8_t *frameAt(size_t i) const { return base + DIR_BYTES + i * stride; }
+
+    const uint8_t *acquire(const char *name)
+    {
+        LockGuard g(lock);
+        int i = indexOf(name);
+        if (i < 0)
+        {
+            stats.misses++;
+            return nullptr;
+        }
+        stats.hits++;
+        readers++;
+        return frameAt(i);
+    }
+
+    void release()
+    {
+        LockGuard g(lock);
+        readers--;
+    }
+
+    // Lock held: forget every entry named `name`. Zeroing the first name
+    // byte needs no erase.
+    void dropEntries(const char *name)
+    {
+        int i;
+        while ((i = indexOf(name)) >= 0)
+        {
+            uint8_t zero = 0;
+            esp_partition_write(part, sizeof(Header) + i * NAME_LEN, &zero, 1);
+            names[i].clear();
+        }
+    }
+
+    static void mirrorEntry(void *arg)
+    {
+        static_cast<FlashFrameStore *>(arg)->runMirror();
+        vTaskDelete(nullptr);
+    }
+
+    void runMirror()
+    {
+        uint32_t t0 = millis();
+        uint16_t n = pending.size();
+        const size_t bytes = frameBytes, step = stride; // resize() may change them meanwhile
+        {
+            // readers fall back to SD while the partition is rewritten
+            LockGuard g(lock);
+            names.clear();
+        }
+        // frames pinned before that are still being copied
+        for (;;)
+        {
+            {
+                LockGuard g(lock);
+                if (!readers)
+                    break;
+            }
+            vTaskDelay(1);
+        }
+        size_t used = DIR_BYTES + n * step;
+        size_t eraseBytes = (used + SPI_FLASH_SEC_SIZE - 1) & ~size_t(SPI_FLASH_SEC_SIZE - 1);
+        bool ok = esp_partition_erase_range(part, 0, eraseBytes) == ESP_OK;
+
+        std::vector<uint8_t> fb(bytes);
+        for (uint16_t i = 0; ok && i < n; i++)
+        {
+            char path[IMAGE_PATH_MAX];
+            ok = imagePath(path, pending[i].c_str()) &&
+                 drv.decodeInto(path, fb.data(), bytes) &&
+                 esp_partition_write(part, DIR_BYTES + i * step, fb.data(), bytes) == ESP_OK;
+            if (!ok)
+                Serial.printf("❌ Mirroring %s to flash failed\n", pending[i].c_str());
+        }
+
+        char entry[NAME_LEN];
+        for (uint16_t i = 0; ok && i < n; i++)
+        {
+            memset(entry, 0, NAME_LEN);
+            memcpy(entry, pending[i].c_str(), pending[i].length());
+            ok = esp_partition_write(part, sizeof(Header) + i * NAME_LEN, entry, NAME_LEN) == ESP_OK;
+        }
+
+        Header h = {MAGIC, VERSION, n, drv.cfg.width, drv.cfg.height, pendingMillis, 0, uint32_t(bytes)};
+        ok = ok && esp_partition_write(part, 0, &h, sizeof(h)) == ESP_OK;
+
+        {
+            LockGuard g(lock);
+            if (ok && bytes == frameBytes)
+            {
+                names = pending;
+                chainMillis = pendingMillis;
+                for (const String &fn : forgotten)
+                    dropEntries(fn.c_str());
+                stats.mirrors++;
+            }
+            else
+                stats.mirrorFailed++;
+            forgotten.clear();
+            stats.mirrorMillis = millis() - t0;
+        }
+        pending.clear();
+        mirroring = false;
+        Serial.printf("Flash tier: mirrored %u frames in %lu ms\n", ok ? n : 0, (unsigned long)stats.mirrorMillis);
+    }
+};
@@ -0,0 +1,59 @@
+// heap_stats.cpp
+#include "heap_stats.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_calloc(size_t n, size_t size);
+extern "C" void *__real_realloc(void *p, size_t size);
+
+// Plain increments: a count lost to a race between cores only makes the
+// numbers slightly low, and atomics are not free on the C3
+static volatile uint32_t allocs = 0;
+static volatile uint32_t taskAllocs[HEAP_TASK_COUNT] = {};
+static TaskHandle_t tracked[HEAP_TASK_COUNT] = {};
+
+static inline void countAlloc()
+{
+    allocs++;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (uint8_t i = 0; i < HEAP_TASK_COUNT; i++)
+    {
+        if (tracked[i] && tracked[i] == self)
+            taskAllocs[i]++;
+    }
+}
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+    countAlloc();
+    return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t n, size_t size)
+{
+    countAlloc();
+    return __real_calloc(n, size);
+}
+
+extern "C" void *__wrap_realloc(void *p, size_t size)
+{
+    if (size)
+        countAlloc();
+    return __real_realloc(p, size);
+}
+
+void heapTrackTask(HeapTask slot, TaskHandle_t task)
+{
+    tracked[slot] = task;
+}
+
+uint32_t heapAllocCount()
+{
+    return allocs;
+}
+
+uint32_t heapTaskAllocCount(HeapTask slot)
+{
+    return taskAllocs[slot];
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+
+// Heap allocation counters. The counting happens in malloc/calloc/realloc
+// wrappers (heap_stats.cpp, linked with -Wl,--wrap=...), so calls to those
+// three are seen wherever they come from: C++ new, Arduino String,
+// ArduinoJson, libraries. Anything that goes to heap_caps_malloc() and
+// friends directly is not: FreeRTOS task stacks and queues, Wi-Fi and lwIP
+// driver buffers, ps_malloc() and other IDF-internal allocations.
+
+// Tasks whose allocations are also counted on their own
+enum HeapTask : uint8_t
+{
+    HEAP_TASK_LOOP = 0, // Arduino loop(), the display side
+    HEAP_TASK_PREFETCH, // frame read-ahead producer
+    HEAP_TASK_COUNT,
+};
+
+// Count allocations made by `task` under slot
+void heapTrackTask(HeapTask slot, TaskHandle_t task);
+// Allocations since boot, all tasks
+uint32_t heapAllocCount();
+// Allocations since boot by the task tracked in slot
+uint32_t heapTaskAllocCount(HeapTask slot);
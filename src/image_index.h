@@ -0,0 +1,78 @@
+// image_index.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <algorithm>
+#include <vector>
+#include "sd_storage.h"
+#include "matrix_driver.h"
+
+// ——— Names of the images in IMAGES_DIR, kept in RAM ———
+// Built by one directory walk (scan()) and kept current by the upload
+// handler, so checking a chain against the card doesn't touch SD. Names are
+// stored lower case, FAT doesn't tell case apart either.
+class ImageIndex
+{
+public:
+    ImageIndex() : lock(xSemaphoreCreateMutex()) {}
+
+    // Walk IMAGES_DIR once; names added while it runs are kept
+    void scan()
+    {
+        uint32_t t0 = millis();
+        std::vector<String> found;
+        File dir = SDCard.open("/images");
+        if (dir)
+        {
+            String f = dir.getNextFileName();
+            while (f.length())
+            {
+                found.push_back(key(f.substring(f.lastIndexOf('/') + 1)));
+                f = dir.getNextFileName();
+            }
+            dir.close();
+        }
+        LockGuard g(lock);
+        names.insert(names.end(), found.begin(), found.end());
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+        scanMillis = millis() - t0;
+        built = true;
+        Serial.printf("🗂️ %u images indexed in %u ms\n", unsigned(names.size()), unsigned(scanMillis));
+    }
+
+    bool ready() const { return built; }
+    size_t size() const { return names.size(); }
+    uint32_t scanMs() const { return scanMillis; }
+
+    // An image was written
+    void add(const String &name)
+    {
+        String k = key(name);
+        LockGuard g(lock);
+        auto it = std::lower_bound(names.begin(), names.end(), k);
+        if (it == names.end() || *it != k)
+            names.insert(it, k);
+    }
+
+    bool contains(const String &name)
+    {
+        String k = key(name);
+        LockGuard g(lock);
+        return std::binary_search(names.begin(), names.end(), k);
+    }
+
+private:
+    SemaphoreHandle_t lock;
+    std::vector<String> names; // sorted
+    volatile bool built = false;
+    uint32_t scanMillis = 0;
+
+    static String key(String name)
+    {
+        name.toLowerCase();
+        return name;
+    }
+};
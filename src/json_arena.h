@@ -0,0 +1,102 @@
+// json_arena.h
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// ——— Preallocated memory for the web handlers' JSON documents ———
+// Handlers run one at a time on the AsyncTCP task and drop their document
+// before returning, so one block (http.jsonArena) serves all of them:
+// allocations are bumped off the block and it starts over as soon as
+// nothing in it is alive. Whatever doesn't fit goes to the heap.
+// ArduinoJson 7 copies every string it parses into the document, even from
+// a mutable buffer, so parsed strings are arena-allocated as well; nothing
+// points back into the request body.
+// Use as `JsonDocument doc(&jsonArena);`
+class ArenaAllocator : public ArduinoJson::Allocator
+{
+public:
+    uint32_t fallbacks = 0; // allocations that didn't fit and went to the heap
+    size_t highWater = 0;   // most of the arena ever in use
+
+    // (Re)allocate the block; false while a document still uses it
+    bool begin(size_t bytes)
+    {
+        if (live)
+            return false;
+        if (bytes == size)
+            return true;
+        free(mem);
+        mem = bytes ? (uint8_t *)malloc(bytes) : nullptr;
+        size = mem ? bytes : 0;
+        used = 0;
+        return true;
+    }
+
+    size_t capacity() const { return size; }
+
+    void *allocate(size_t n) override
+    {
+        size_t need = HEADER + align(n);
+        if (used + need > size)
+        {
+            fallbacks++;
+            return malloc(n);
+        }
+        uint8_t *blk = mem + used;
+        *(size_t *)blk = n;
+        used += need;
+        live++;
+        highWater = std::max(highWater, used);
+        return blk + HEADER;
+    }
+
+    void deallocate(void *p) override
+    {
+        if (!owns(p))
+        {
+            free(p);
+            return;
+        }
+        if (--live == 0)
+            used = 0;
+    }
+
+    void *reallocate(void *p, size_t n) override
+    {
+        if (!p)
+            return allocate(n);
+        if (!owns(p))
+            return realloc(p, n);
+        uint8_t *blk = (uint8_t *)p - HEADER;
+        size_t old = *(size_t *)blk;
+        size_t start = blk - mem;
+        // the newest block grows and shrinks in place (string building,
+        // shrinkToFit), others only shrink in place
+        if (start + HEADER + align(old) == used && start + HEADER + align(n) <= size)
+        {
+            used = start + HEADER + align(n);
+            highWater = std::max(highWater, used);
+            *(size_t *)blk = n;
+            return p;
+        }
+        if (n <= old)
+            return p;
+        void *q = allocate(n);
+        if (q)
+        {
+            memcpy(q, p, old);
+            deallocate(p);
+        }
+        return q;
+    }
+
+private:
+    static const size_t HEADER = 8; // block size, keeps payloads 8-byte aligned
+    uint8_t *mem = nullptr;
+    size_t size = 0, used = 0;
+    uint32_t live = 0;
+
+    static size_t align(size_t n) { return (n + 7) & ~size_t(7); }
+    bool owns(void *p) const { return p >= mem && p < mem + size; }
+};
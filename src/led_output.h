@@ -0,0 +1,220 @@
+// led_output.h
+#pragma once
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <Adafruit_NeoPixel.h>
+#include <soc/soc_caps.h>
+#include <vector>
+
+// ——— LED bus types (WLED numbering, hw.led.ins[].type) ———
+#define LED_TYPE_WS2812_RGB 22
+#define LED_TYPE_WS2811_400KHZ 24
+#define LED_TYPE_SK6812_RGBW 30
+#define LED_TYPE_APA102 51
+
+// ——— Color orders (WLED numbering, hw.led.ins[].order) ———
+enum ColorOrder : uint8_t
+{
+    ORDER_GRB = 0,
+    ORDER_RGB = 1,
+    ORDER_BRG = 2,
+    ORDER_RBG = 3,
+    ORDER_BGR = 4,
+    ORDER_GBR = 5,
+};
+
+// ——— Raw wire-order pixel buffer + transfer ———
+// Each LED occupies `stride` bytes starting at pixels + i * stride; the
+// color bytes start `lead` bytes into that slot (APA102 has a header byte).
+class LedOutput
+{
+public:
+    uint8_t *pixels = nullptr;
+    uint16_t count = 0;
+    uint8_t stride = 3;
+    uint8_t lead = 0;
+
+    virtual ~LedOutput() {}
+    virtual void begin() = 0;
+    virtual void show() = 0;
+};
+
+// WS2812 / WS2811 / SK6812 via Adafruit_NeoPixel. The strip is always
+// created in identity (RGB/RGBW) order: the blit kernel writes wire order
+// straight into its buffer, so NeoPixel never reorders anything.
+class NeoPixelOutput : public LedOutput
+{
+public:
+    Adafruit_NeoPixel strip;
+
+    NeoPixelOutput(uint16_t len, uint8_t pin, bool rgbw, bool khz400)
+        : strip(len, pin, (rgbw ? NEO_RGBW : NEO_RGB) + (khz400 ? NEO_KHZ400 : NEO_KHZ800))
+    {
+        pixels = strip.getPixels();
+        count = strip.numPixels();
+        stride = rgbw ? 4 : 3; // W byte stays 0
+    }
+
+    void begin() override
+    {
+        strip.begin();
+        strip.clear();
+    }
+    void show() override { strip.show(); }
+};
+
+// APA102 (DotStar) on a clocked SPI bus: pin[0] = data, pin[1] = clock.
+// The whole transfer (start frame, LEDs, end frame) lives in one buffer so
+// show() is a single bulk write.
+class Apa102Output : public LedOutput
+{
+public:
+    Apa102Output(uint16_t len, uint8_t dataPin, uint8_t clockPin, uint32_t khz)
+        : dataPin(dataPin), clockPin(clockPin), hz(khz * 1000)
+    {
+        // 4 zero bytes start frame, 4 bytes per LED, >= len/2 clock edges end frame
+        buf.assign(4 + size_t(len) * 4 + (len + 15) / 16, 0xFF);
+        std::fill(buf.begin(), buf.begin() + 4, 0x00);
+        pixels = buf.data() + 4;
+        count = len;
+        stride = 4;
+        lead = 1;
+    }
+
+    ~Apa102Output() override
+    {
+#if SOC_SPI_PERIPH_NUM > 2
+        if (spi)
+        {
+            spi->end();
+            delete spi;
+        }
+#endif
+    }
+
+    void begin() override
+    {
+        // LED header byte = 0xE0 | 5-bit global current, keep it at full and
+        // let the blit scale the color bytes
+        for (uint16_t i = 0; i < count; i++)
+        {
+            uint8_t *p = pixels + i * stride;
+            p[0] = 0xFF;
+            p[1] = p[2] = p[3] = 0;
+        }
+#if SOC_SPI_PERIPH_NUM > 2
+        // SD owns the default bus, the LEDs get their own peripheral
+        spi = new SPIClass(HSPI);
+        spi->begin(clockPin, -1, dataPin, -1);
+#else
+        // single general-purpose SPI (ESP32-C3) is taken by the SD card
+        pinMode(dataPin, OUTPUT);
+        pinMode(clockPin, OUTPUT);
+        digitalWrite(clockPin, LOW);
+#endif
+    }
+
+    void show() override
+    {
+#if SOC_SPI_PERIPH_NUM > 2
+        spi->beginTransaction(SPISettings(hz, MSBFIRST, SPI_MODE0));
+        spi->writeBytes(buf.data(), buf.size());
+        spi->endTransaction();
+#else
+        for (uint8_t b : buf)
+        {
+            for (uint8_t bit = 0x80; bit; bit >>= 1)
+            {
+                digitalWrite(dataPin, (b & bit) ? HIGH : LOW);
+                digitalWrite(clockPin, HIGH);
+                digitalWrite(clockPin, LOW);
+            }
+        }
+#endif
+    }
+
+private:
+    std::vector<uint8_t> buf;
+    uint8_t dataPin, clockPin;
+    uint32_t hz;
+#if SOC_SPI_PERIPH_NUM > 2
+    SPIClass *spi = nullptr;
+#endif
+};
+
+// Build the output for a WLED bus type; unknown types fall back to WS2812.
+static LedOutput *makeLedOutput(uint8_t type, uint16_t len, uint8_t pin,
+                                uint8_t clockPin, uint32_t khz)
+{
+    switch (type)
+    {
+    case LED_TYPE_APA102:
+        if (clockPin != 0xFF)
+            return new Apa102Output(len, pin, clockPin, khz);
+        Serial.println("⚠️ APA102 needs a clock pin (pin[1]), using WS2812");
+        break;
+    case LED_TYPE_SK6812_RGBW:
+        return new NeoPixelOutput(len, pin, true, false);
+    case LED_TYPE_WS2811_400KHZ:
+        return new NeoPixelOutput(len, pin, false, true);
+    case LED_TYPE_WS2812_RGB:
+        break;
+    default:
+        Serial.printf("⚠️ Unsupported LED type %u, using WS2812\n", type);
+        break;
+    }
+    return new NeoPixelOutput(len, pin, false, false);
+}
+
+// ——— Blit kernels: RGB888 framebuffer → wire-order LED buffer ———
+// One instantiation per color order, so the byte offsets are constants and
+// the per-pixel loop is just scale + store. Returns how much the sum of the
+// color bytes in `out` changed (written minus overwritten), which is what
+// the power limiter in MatrixDriver keeps its current estimate with.
+typedef int32_t (*BlitFn)(const uint8_t *fb, const int32_t *map, size_t n,
+                          uint8_t *out, uint8_t stride, uint16_t scale);
+
+template <uint8_t RO, uint8_t GO, uint8_t BO>
+static int32_t blitKernel(const uint8_t *fb, const int32_t *map, size_t n,
+                          uint8_t *out, uint8_t stride, uint16_t scale)
+{
+    int32_t delta = 0;
+    for (size_t i = 0; i < n; i++, fb += 3)
+    {
+        int32_t led = map[i];
+        if (led < 0)
+            continue;
+        uint8_t *p = out + uint32_t(led) * stride;
+        uint8_t r = (fb[0] * scale) >> 8;
+        uint8_t g = (fb[1] * scale) >> 8;
+        uint8_t b = (fb[2] * scale) >> 8;
+        delta += int32_t(r + g + b) - (p[RO] + p[GO] + p[BO]);
+        p[RO] = r;
+        p[GO] = g;
+        p[BO] = b;
+    }
+    return delta;
+}
+
+static BlitFn blitKernelFor(uint8_t order)
+{
+    switch (order)
+    {
+    case ORDER_RGB:
+        return blitKernel<0, 1, 2>;
+    case ORDER_BRG:
+        return blitKernel<1, 2, 0>;
+    case ORDER_RBG:
+        return blitKernel<0, 2, 1>;
+    case ORDER_BGR:
+        return blitKernel<2, 1, 0>;
+    case ORDER_GBR:
+        return blitKernel<2, 0, 1>;
+    case ORDER_GRB:
+        return blitKernel<1, 0, 2>;
+    default:
+        Serial.printf("⚠️ Unsupported color order %u, using GRB\n", order);
+        return blitKernel<1, 0, 2>;
+    }
+}
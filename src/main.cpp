@@ -3,6 +3,18 @@
 #include <ESPAsyncWebServer.h>
 #include "config.h"
 #include "matrix_driver.h"
+#include "frame_prefetch.h"
+#include "frame_store.h"
+#include "static_assets.h"
+#include "upload_pool.h"
+#include "json_arena.h"
+#include "heap_stats.h"
+#include "text_ticker.h"
+#include "effects.h"
+#include "crossfade.h"
+#include "chain_sync.h"
+#include "image_index.h"
+#include "chain_validator.h"
 #include "base64.hpp"
 #include <vector>
 #include "virtual_file.h"
@@ -11,6 +23,23 @@
 AsyncWebServer server(80);
 ConfigReader config;
 MatrixDriver *driver;
+FramePrefetcher *prefetch = nullptr; // null when display.prefetch is 0
+FlashFrameStore *flashStore = nullptr; // null without a frames partition
+StaticAssets staticAssets;
+UploadPool *uploads;
+ArenaAllocator jsonArena; // backs the handlers' JSON documents
+TextTicker ticker;        // /api/text, replaces the chain while active
+EffectEngine effects;     // /api/effect, same
+Crossfader fader;         // display.crossfade, blends chain frames in loop()
+ChainSync chainSync;      // sync.role, shares the chain timeline over UDP
+ImageIndex imageIndex;    // names in /images, checked instead of SD
+ChainValidator *validator; // resolves posted chains against imageIndex
+
+// Request body limits, larger bodies get a 413
+static const size_t MAX_IMG_BODY = 128 * 1024;    // JSON with a base64 image
+static const size_t MAX_DISPLAY_BODY = 64 * 1024; // raw BMP / PNG, region packets
+static const size_t MAX_JSON_BODY = 16 * 1024;    // chains
+static const size_t MAX_CONFIG_BODY = 64 * 1024;
 
 // Frame‐chain
 static const uint8_t MAX_CHAIN = 100;                      // TODO: make dynamic by config file
@@ -20,22 +49,286 @@ uint8_t chainLength = 0;
 uint8_t currentFrame = 0;
 uint16_t frameDuration = 1000 / 24; // default 24 FPS
 unsigned long lastUpdate = 0;
+bool chainIdle = false; // single-frame chain already on screen
+volatile uint32_t imagesWritten = 0; // uploads, counted by the web task
+uint32_t imagesSeen = 0;             // loop()'s copy, a new upload ends chainIdle
+uint16_t chainLoops = 0; // completed passes of the current chain
+static const uint16_t IDLE_SLEEP_MS = 50; // max loop() sleep while nothing changes
+uint32_t lastFrameAllocs = 0; // heap allocations by loop() for the last frame
+unsigned long lastBlend = 0;  // last crossfaded output frame
+uint32_t configsApplied = 0;  // POST /api/config, /api/config/reload
+uint32_t configApplyMs = 0;   // last switch, in loop()
+
+// ——— Show chain entry i: from the flash tier if mirrored there, else SD ———
+bool showChainFrame(uint8_t i)
+{
+    const String &fn = imageChain[i];
+    if (!fn.length())
+        return false;
+    FlashFrameStore::Pin cached(flashStore, fn.c_str());
+    if (cached)
+    {
+        return driver->showFrame(cached.data(), flashStore->frameSize());
+    }
+    // fixed buffer: this runs for every frame and must not allocate
+    char path[IMAGE_PATH_MAX];
+    if (!imagePath(path, fn.c_str()))
+        return false;
+    return driver->drawImage(path); // reports a missing file itself
+}
 
-// ——— Helper to slurp a file into a byte buffer ———
-bool readFileToBuffer(const String &path, std::vector<uint8_t> &outBuf)
+// ——— (Re)start playback of imageChain from frame 0 ———
+void startChain()
 {
-    outBuf.clear();
-    File f = SD.open(path, FILE_READ);
-    if (!f)
+    currentFrame = 0;
+    chainLoops = 0;
+    lastUpdate = millis();
+    chainIdle = false;
+    fader.restart();
+    if (chainSync.leading())
+        chainSync.restart();
+
+    // Draw the first frame immediately, the player continues with frame 1
+    if (chainLength)
+    {
+        showChainFrame(0);
+        currentFrame = 1 % chainLength;
+    }
+
+    // Frame 0 is up, read ahead from frame 1 on. A chain held completely by
+    // the flash tier needs no read-ahead.
+    if (prefetch)
+    {
+        if (chainLength > 1 && !(flashStore && flashStore->holdsAll(imageChain, chainLength)))
+            prefetch->start(imageChain, chainLength, 1);
+        else
+            prefetch->stop();
+    }
+}
+
+// ——— Step to chain entry `next`, counting completed loops ———
+void advanceFrame(uint8_t next)
+{
+    currentFrame = next;
+    if (next != 0)
+        return;
+    chainLoops++;
+    if (flashStore && config.flashLoops && chainLoops == config.flashLoops)
+        flashStore->mirror(imageChain, chainLength, frameDuration);
+}
+
+// ——— Chain entry i into the crossfader: from the flash tier or SD ———
+bool fadeInChainFrame(uint8_t i)
+{
+    const String &fn = imageChain[i];
+    if (!fn.length())
         return false;
-    while (f.available())
+    FlashFrameStore::Pin cached(flashStore, fn.c_str());
+    if (cached)
+        return fader.take(cached.data(), flashStore->frameSize());
+    char path[IMAGE_PATH_MAX];
+    return imagePath(path, fn.c_str()) && fader.decode(*driver, path);
+}
+
+// ——— Crossfading playback (display.crossfade) ———
+// Chain frames are due every frameDuration as without blending; in between
+// an output frame every fader.interval() ms fades from the previous chain
+// frame to the newest. The first frame after a (re)start is cut to.
+void stepCrossfade()
+{
+    unsigned long now = millis();
+    if (now - lastUpdate >= frameDuration)
+    {
+        uint32_t a0 = heapTaskAllocCount(HEAP_TASK_LOOP);
+        if (prefetch && prefetch->active())
+        {
+            uint8_t index;
+            const uint8_t *fb = prefetch->front(index);
+            if (!fb)
+            {
+                delay(1);
+                return;
+            }
+            fader.take(fb, prefetch->frameSize());
+            prefetch->pop();
+            advanceFrame((index + 1) % chainLength);
+        }
+        else
+        {
+            fadeInChainFrame(currentFrame);
+            advanceFrame((currentFrame + 1) % chainLength);
+        }
+        lastUpdate = now;
+        lastBlend = now - fader.interval(); // start the fade right away
+        lastFrameAllocs = heapTaskAllocCount(HEAP_TASK_LOOP) - a0;
+    }
+
+    unsigned long sinceBlend = now - lastBlend;
+    if (sinceBlend < fader.interval())
     {
-        outBuf.push_back(f.read());
+        unsigned long untilFrame = frameDuration - std::min<unsigned long>(now - lastUpdate, frameDuration);
+        delay(std::max<unsigned long>(1, std::min<unsigned long>(fader.interval() - sinceBlend, untilFrame)));
+        return;
     }
-    f.close();
+    lastBlend = now;
+    uint32_t t = frameDuration ? (now - lastUpdate) * 256 / frameDuration : 256;
+    fader.show(*driver, std::min<uint32_t>(t, 256));
+}
+
+// ——— Synchronized playback (sync.role) ———
+// Timeline position: ms into the current pass of the chain
+uint32_t chainPosition(unsigned long now)
+{
+    uint8_t shown = (currentFrame + chainLength - 1) % chainLength;
+    return (uint32_t(shown) * frameDuration + (now - lastUpdate)) % (uint32_t(chainLength) * frameDuration);
+}
+
+// Pull the frame timing towards the leader's timeline: less than a frame
+// off, a quarter of the error is taken off the current frame's time; a
+// restarted chain or a larger error jumps to the leader's frame.
+void followSync(unsigned long now)
+{
+    uint32_t leaderPos;
+    bool restarted;
+    if (!frameDuration || !chainSync.take(now, chainLength, frameDuration, leaderPos, restarted))
+        return;
+    int32_t period = int32_t(chainLength) * frameDuration;
+    int32_t err = int32_t(leaderPos) - int32_t(chainPosition(now));
+    if (err > period / 2)
+        err -= period;
+    else if (err < -period / 2)
+        err += period;
+    chainSync.stats.errorMs = err;
+
+    if (!restarted && abs(err) < frameDuration)
+    {
+        // behind: the next frame comes sooner; ahead: later, but the current
+        // frame can't start in the future
+        int32_t shift = err / 4;
+        if (shift < 0)
+            shift = -int32_t(std::min<unsigned long>(-shift, now - lastUpdate));
+        lastUpdate -= shift;
+        chainSync.stats.slewed++;
+        return;
+    }
+    uint8_t target = leaderPos / frameDuration;
+    showChainFrame(target);
+    lastUpdate = now - leaderPos % frameDuration;
+    currentFrame = (target + 1) % chainLength;
+    if (prefetch && prefetch->active())
+        prefetch->start(imageChain, chainLength, currentFrame);
+    fader.restart();
+    chainIdle = false;
+    chainSync.stats.jumps++;
+}
+
+// ——— Play a chain resolved by the validator (POST /api/imgchain) ———
+// Only frames that exist are in it, playback never looks for missing files
+bool takeValidatedChain()
+{
+    uint8_t len;
+    uint16_t duration;
+    bool pin;
+    if (!validator->take(imageChain, MAX_CHAIN, len, duration, pin))
+        return false;
+    for (uint8_t i = len; i < chainLength; i++)
+        imageChain[i].clear();
+    chainLength = len;
+    frameDuration = duration;
+    Serial.printf("Playing chain of %u frames, %u ms per frame\n", chainLength, frameDuration);
+    ticker.stop();
+    effects.stop();
+    startChain();
+    if (flashStore && pin)
+        flashStore->mirror(imageChain, chainLength, frameDuration);
+    return true;
+}
+
+// ——— Switch to text or an effect requested by the web task ———
+// POST /api/text and /api/effect only validate and prepare; chainLength,
+// frameDuration, lastUpdate and the read-ahead belong to loop(), which
+// stops the chain and starts the new mode between two frames.
+enum ModeSwitch : uint8_t
+{
+    SWITCH_NONE,
+    SWITCH_TEXT,
+    SWITCH_EFFECT,
+};
+SemaphoreHandle_t switchLock = xSemaphoreCreateMutex();
+uint8_t pendingSwitch = SWITCH_NONE; // newest request wins
+uint16_t pendingFrameMs = 0;
+
+void requestSwitch(uint8_t mode, uint16_t frameMs)
+{
+    LockGuard g(switchLock);
+    pendingSwitch = mode;
+    pendingFrameMs = frameMs;
+}
+
+// DELETE: stop `mode`, also if loop() hasn't switched to it yet
+void stopMode(uint8_t mode)
+{
+    LockGuard g(switchLock);
+    if (pendingSwitch == mode)
+        pendingSwitch = SWITCH_NONE;
+    if (mode == SWITCH_TEXT)
+        ticker.stop();
+    else if (mode == SWITCH_EFFECT)
+        effects.stop();
+}
+
+bool takeModeSwitch()
+{
+    LockGuard g(switchLock);
+    if (pendingSwitch == SWITCH_NONE)
+        return false;
+    // the chain stops, its timing drives the ticker / effect
+    chainLength = 0;
+    if (prefetch)
+        prefetch->stop();
+    frameDuration = pendingFrameMs;
+    lastUpdate = 0;
+    if (pendingSwitch == SWITCH_TEXT)
+    {
+        effects.stop();
+        ticker.start();
+    }
+    else
+    {
+        ticker.stop();
+        effects.start();
+    }
+    pendingSwitch = SWITCH_NONE;
+    return true;
+}
+
+// ——— "RRGGBB" / "#RRGGBB" → rgb, false if v is not a string ———
+bool parseColor(JsonVariantConst v, uint8_t rgb[3])
+{
+    if (!v.is<const char *>())
+        return false;
+    const char *s = v.as<const char *>();
+    uint32_t c = strtoul(s + (*s == '#'), nullptr, 16);
+    rgb[0] = c >> 16;
+    rgb[1] = c >> 8;
+    rgb[2] = c;
     return true;
 }
 
+// ——— Region update packet → framebuffer ———
+// The same bytes from POST /api/region or a streaming transport:
+//   int16 x, int16 y, uint16 w, uint16 h (little endian), w * h * 3 bytes RGB888
+// False if the packet is malformed.
+static const size_t REGION_HEADER = 8;
+bool drawRegionPacket(const uint8_t *p, size_t len)
+{
+    if (len < REGION_HEADER)
+        return false;
+    int16_t x = int16_t(p[0] | p[1] << 8), y = int16_t(p[2] | p[3] << 8);
+    uint16_t w = p[4] | p[5] << 8, h = p[6] | p[7] << 8;
+    return driver->drawRegion(x, y, w, h, p + REGION_HEADER, len - REGION_HEADER);
+}
+
 // ——— HTTP Handlers ———
 
 // ——— GET /api/img?file=<FILENAME> ———
@@ -49,40 +342,67 @@ void handleGetImage(AsyncWebServerRequest *req)
     String filename = req->getParam("file")->value();
     String path = "/images/" + filename;
 
-    if (!SD.exists(path))
+    if (!SDCard.exists(path))
     {
         req->send(404, "application/json", "{\"error\":\"not found\"}");
         return;
     }
 
-    // Read raw bytes
-    std::vector<uint8_t> buf;
-    if (!readFileToBuffer(path, buf))
+    File f = SDCard.open(path, FILE_READ);
+    if (!f)
     {
         req->send(500, "application/json", "{\"error\":\"fs read\"}");
         return;
     }
 
-    // Base64-encode
-    unsigned int encLen = encode_base64_length(buf.size());
-    unsigned char *outB = (unsigned char *)malloc(encLen + 1);
-    unsigned int actual = encode_base64(buf.data(), buf.size(), outB);
-    outB[actual] = '\0';
-    String b64((char *)outB);
-    free(outB);
+    // Base64-encode straight from the file into the response, a multiple
+    // of 3 bytes at a time so only the last chunk is padded
+    AsyncResponseStream *res = req->beginResponseStream("application/json");
+    res->print("{\"file\":\"");
+    res->print(filename);
+    res->print("\",\"img\":\"");
+    uint8_t raw[768];
+    unsigned char enc[1024 + 1];
+    size_t n;
+    do
+    {
+        n = 0;
+        while (n < sizeof(raw) && f.available())
+            n += f.read(raw + n, sizeof(raw) - n);
+        if (n)
+            res->write(enc, encode_base64(raw, n, enc));
+    } while (n == sizeof(raw));
+    f.close();
+    res->print("\"}");
+    req->send(res);
+}
 
-    // Build JSON response
-    DynamicJsonDocument doc(2048);
-    doc["img"] = b64;
-    doc["file"] = filename;
-    String resp;
-    serializeJson(doc, resp);
-    req->send(200, "application/json", resp);
+// GET /api/framebuffer?format=ppm|raw
+// What the LEDs show (frame with overlays, before brightness): a binary PPM
+// (P6), or with format=raw the bare RGB888 rows, size in X-Width/X-Height.
+void handleGetFramebuffer(AsyncWebServerRequest *req)
+{
+    static std::vector<uint8_t> snap; // web task only, the stream copies it
+    uint16_t w, h;
+    driver->snapshot(snap, w, h);
+    bool raw = req->hasParam("format") && req->getParam("format")->value() == "raw";
+    AsyncResponseStream *res = req->beginResponseStream(raw ? "application/octet-stream" : "image/x-portable-pixmap");
+    if (raw)
+    {
+        res->addHeader("X-Width", String(w));
+        res->addHeader("X-Height", String(h));
+    }
+    else
+    {
+        res->printf("P6\n%u %u\n255\n", w, h);
+    }
+    res->write(snap.data(), snap.size());
+    req->send(res);
 }
 
 void handlePostBrightness(AsyncWebServerRequest *req, uint8_t *data, size_t len)
 {
-    DynamicJsonDocument doc(256);
+    JsonDocument doc(&jsonArena);
     if (deserializeJson(doc, data, len))
     {
         req->send(400, "application/json", "{\"error\":\"bad json\"}");
@@ -93,21 +413,22 @@ void handlePostBrightness(AsyncWebServerRequest *req, uint8_t *data, size_t len)
     if (newBrightness > 255)
         newBrightness = 255;
 
-    // Update the brightness
+    // Update the brightness, loop() re-shows the current frame with it
     driver->brightness = newBrightness;
+    driver->refreshPending = true;
 
     req->send(200, "application/json", "{\"status\":\"ok\"}");
 }
 
 // ——— POST /api/img { "file":"…", "img":"<base64-BMP>" } ———
-void handlePostImageComplete(AsyncWebServerRequest *req, const String &body)
+void handlePostImageComplete(AsyncWebServerRequest *req, uint8_t *body, size_t len)
 {
-    // 1. Allocate a JSON document just big enough (with a little wiggle room)
-    size_t capacity = body.length() * 15 / 10 + 512;
-    DynamicJsonDocument doc(capacity);
+    // 1. Document in the JSON arena (the base64 string itself won't fit and
+    //    goes to the heap for the duration of this call)
+    JsonDocument doc(&jsonArena);
 
     // 2. Parse
-    auto err = deserializeJson(doc, body);
+    auto err = deserializeJson(doc, (char *)body, len);
     if (err)
     {
         Serial.printf("❌ JSON parse failed: %s\n", err.c_str());
@@ -117,35 +438,34 @@ void handlePostImageComplete(AsyncWebServerRequest *req, const String &body)
 
     // 3. Extract fields
     String filename = doc["file"] | "";
-    String b64data = doc["img"] | "";
-    if (filename.isEmpty() || b64data.isEmpty())
+    const char *b64data = doc["img"] | "";
+    size_t b64len = strlen(b64data);
+    if (filename.isEmpty() || !b64len)
     {
         req->send(400, "application/json", "{\"error\":\"missing file or img\"}");
         return;
     }
 
-    // 4. Decode Base64
-    unsigned int expectedLen = decode_base64_length((const unsigned char *)b64data.c_str(), b64data.length());
-    auto *buf = (uint8_t *)malloc(expectedLen);
-    if (!buf)
-    {
-        req->send(500, "application/json", "{\"error\":\"memory alloc failed\"}");
-        return;
-    }
-    unsigned int actualLen = decode_base64((const unsigned char *)b64data.c_str(), b64data.length(), buf);
+    // 4. Decode Base64 into the upload buffer, the document holds its own
+    //    copy of the string and the decoded image is smaller than the body
+    uint8_t *buf = body;
+    unsigned int actualLen = decode_base64((const unsigned char *)b64data, b64len, buf);
 
-    // 5. Write to SD
+    // 5. Write to SD, contiguous so playback reads never walk the FAT
     String path = "/images/" + filename;
-    File f = SD.open(path, FILE_WRITE);
+    File f = SDCard.openPreallocated(path.c_str(), actualLen);
     if (!f)
     {
-        free(buf);
         req->send(500, "application/json", "{\"error\":\"fs write\"}");
         return;
     }
     f.write(buf, actualLen);
     f.close();
-    free(buf);
+    imageIndex.add(filename);
+    driver->forgetSource();
+    if (flashStore)
+        flashStore->forget(filename.c_str());
+    imagesWritten++; // loop() redraws, the static frame may just have been replaced
 
     // 6. Success response
     String resp = String("{\"file\":\"") + filename + "\"}";
@@ -155,13 +475,12 @@ void handlePostImageComplete(AsyncWebServerRequest *req, const String &body)
 // POST /api/imgchain { "chain":["1","2",…], "fps":12.5, ?"num":1 }
 void handlePostImgChain(AsyncWebServerRequest *req, uint8_t *data, size_t len)
 {
-    const String &body = String((const char *)data, len);
 #if DEBUG
-    Serial.printf("Received imgchain POST: %s\n", body.c_str());
+    Serial.printf("Received imgchain POST: %.*s\n", int(len), (const char *)data);
 #endif
 
-    JsonDocument doc;
-    if (deserializeJson(doc, body))
+    JsonDocument doc(&jsonArena);
+    if (deserializeJson(doc, data, len))
     {
         req->send(400, "application/json", "{\"error\":\"bad json\"}");
         return;
@@ -185,63 +504,37 @@ void handlePostImgChain(AsyncWebServerRequest *req, uint8_t *data, size_t len)
         return;
     }
 
-#if DEBUG
-    Serial.println("Cleared old image chain");
-#endif
-
-    // Clear out any old entries
-    for (uint8_t i = 0; i < MAX_CHAIN; i++)
+    // Compute our per‐frame delay
+    float fps = doc["fps"].is<float>() ? doc["fps"].as<float>() : 1.0;
+    if (fps <= 0)
     {
-        imageChain[i].clear();
+        req->send(400, "application/json", "{\"error\":\"invalid fps\"}");
+        return;
     }
-    chainLength = 0;
+    uint16_t duration = static_cast<uint16_t>(1000.0 / fps);
 
+    // keep the extension (BMP or PNG), bare names are BMPs
+    std::vector<String> chain;
     for (uint8_t i = 0; i < arr.size() && i < MAX_CHAIN; i++)
     {
         String fn = arr[i].as<String>();
-        String path = "/images/" + fn;
-        /* //Future: re-enable file existence check (thats faster and not blocking!)
-        if (!SD.exists(path))
-        {
-            req->send(404, "application/json",
-                      "{\"error\":\"file not found: " + fn + "\"}");
-            return;
-        }*/
-        // strip “.bmp” so we can re‐add it later in loop()
-        imageChain[i] = fn.substring(0, fn.lastIndexOf('.'));
-        chainLength++;
-        Serial.printf("Added to chain[%u]: %s\n", i, imageChain[i].c_str());
+        chain.push_back(fn.lastIndexOf('.') < 0 ? fn + ".bmp" : fn);
     }
+    uint8_t frames = chain.size();
 
 #if DEBUG
-    Serial.printf("Received chain of %u images\n", arr.size());
+    Serial.printf("Received chain of %u images, %u ms per frame\n", arr.size(), duration);
 #endif
 
-    // Compute our per‐frame delay
-    float fps = doc["fps"].is<float>() ? doc["fps"].as<float>() : 1.0;
-    if (fps <= 0)
+    // the job is only queued once the chain file is written, refuse now if
+    // it couldn't be
+    if (!validator->canSubmit())
     {
-        req->send(400, "application/json", "{\"error\":\"invalid fps\"}");
+        AsyncWebServerResponse *res = req->beginResponse(503, "application/json", "{\"error\":\"busy\"}");
+        res->addHeader("Retry-After", "1");
+        req->send(res);
         return;
     }
-    frameDuration = static_cast<uint16_t>(1000.0 / fps);
-
-    // #ifdef DEBUG
-    Serial.printf("FPS as String: %s\n", doc["fps"].as<String>().c_str());
-    Serial.printf("FPS: %.2f\n", fps);
-    Serial.printf("frameDuration: %u ms\n", frameDuration);
-    // #endif
-
-    // Reset playback
-    currentFrame = 0;
-    lastUpdate = millis();
-
-    // Draw the first frame immediately
-    if (chainLength)
-    {
-        String p = "/images/" + imageChain[0] + ".bmp";
-        driver->drawBMP(p.c_str());
-    }
 
     int chainNum = -1;
 
@@ -252,7 +545,7 @@ void handlePostImgChain(AsyncWebServerRequest *req, uint8_t *data, size_t len)
     else
     {
         // Store as csv in /imgchain/<number>.chain as: "frame_duration"\n"frame1.bmp"\n"frame2.bmp"\n…
-        File dir = SD.open("/imgchain");
+        File dir = SDCard.open("/imgchain");
 
         String nm = dir.getNextFileName();
         int maxNum = 0;
@@ -267,7 +560,7 @@ void handlePostImgChain(AsyncWebServerRequest *req, uint8_t *data, size_t len)
 
             if (lowerNm.endsWith(".chain"))
             {
-                String base = lowerNm.substring(0, lowerNm.lastIndexOf('.'));
+                String base = lowerNm.substring(lowerNm.lastIndexOf('/') + 1, lowerNm.lastIndexOf('.'));
                 int num = base.toInt();
                 if (num > maxNum)
                     maxNum = num;
@@ -284,31 +577,78 @@ void handlePostImgChain(AsyncWebServerRequest *req, uint8_t *data, size_t len)
 
     String chainPath = "/imgchain/" + String(chainNum) + ".chain";
 
-    if (SD.exists(chainPath))
+    String backup = chainPath + ".bak";
+    bool replaced = SDCard.exists(chainPath);
+    if (replaced)
     {
-        SD.rename(chainPath, chainPath + ".bak");
+        SDCard.rename(chainPath, backup);
     }
 
-    File f = SD.open(chainPath, FILE_WRITE);
+    File f = SDCard.open(chainPath, FILE_WRITE);
     if (!f)
     {
+        // nothing changes then: no job is queued, the old file is back
+        if (replaced)
+            SDCard.rename(backup, chainPath);
         req->send(500, "application/json", "{\"error\":\"fs write chain\"}");
         return;
     }
-    f.printf("%u\n", frameDuration);
-    for (uint8_t i = 0; i < chainLength; i++)
+    f.printf("%u\n", duration);
+    for (uint8_t i = 0; i < frames; i++)
     {
-        f.printf("%s\n", imageChain[i].c_str());
+        f.printf("%s\n", chain[i].c_str());
     }
 
     f.close();
 
-    req->send(200, "application/json", "{\"status\":\"ok\", \"chainNum\":\"" + String(chainNum) + "\"}");
+    // Frames are checked against the image index in the background; loop()
+    // starts the chain with the ones that exist ("pin" keeps it in the flash
+    // tier). GET /api/imgchain?job=<id> reports the result.
+    uint32_t job = validator->submit(chain.data(), frames, duration, doc["pin"].as<bool>());
+
+    req->send(200, "application/json", "{\"status\":\"ok\", \"chainNum\":\"" + String(chainNum) + "\", \"job\":" + String(job) + "}");
+}
+
+// GET /api/imgchain?job=<ID> — result of the check started by a POST:
+// { "job":3, "state":"done", "requested":24, "resolved":23, "missing":["x.bmp"], "started":true }
+void handleGetChainJob(AsyncWebServerRequest *req)
+{
+    uint32_t id = req->getParam("job")->value().toInt();
+    ChainValidator::Result r;
+    if (!validator->result(id, r))
+    {
+        req->send(404, "application/json", "{\"error\":\"unknown job\"}");
+        return;
+    }
+    JsonDocument doc(&jsonArena);
+    doc["job"] = id;
+    doc["state"] = r.state == ChainValidator::JOB_DONE ? "done" : "queued";
+    doc["requested"] = r.requested;
+    if (r.state == ChainValidator::JOB_DONE)
+    {
+        doc["resolved"] = r.resolved;
+        doc["missingCount"] = r.missing;
+        JsonArray missing = doc["missing"].to<JsonArray>(); // the first MAX_REPORTED
+        for (const String &fn : r.missingNames)
+            missing.add(fn);
+        doc["checkUs"] = r.micros;
+        doc["started"] = r.started;
+        if (!r.resolved)
+            doc["error"] = "no frames found";
+    }
+    String out;
+    serializeJson(doc, out);
+    req->send(200, "application/json", out);
 }
 
 // get /api/imgchain?num=<NUMBER> // this returns the file content list -> { "chain":["1","2",…], "fps":12.5, "num":1 }
 void handleGetImgChain(AsyncWebServerRequest *req)
 {
+    if (req->hasParam("job"))
+    {
+        handleGetChainJob(req);
+        return;
+    }
     if (!req->hasParam("num"))
     {
         req->send(400, "application/json", "{\"error\":\"missing num\"}");
@@ -317,13 +657,13 @@ void handleGetImgChain(AsyncWebServerRequest *req)
     String numStr = req->getParam("num")->value();
     String path = "/imgchain/" + numStr + ".chain";
 
-    if (!SD.exists(path))
+    if (!SDCard.exists(path))
     {
         req->send(404, "application/json", "{\"error\":\"not found\"}");
         return;
     }
 
-    File f = SD.open(path, FILE_READ);
+    File f = SDCard.open(path, FILE_READ);
     if (!f)
     {
         req->send(500, "application/json", "{\"error\":\"fs read chain\"}");
@@ -337,7 +677,7 @@ void handleGetImgChain(AsyncWebServerRequest *req)
     float fps = duration > 0 ? 1000.0f / duration : 1.0f;
 
     // Read rest: image filenames
-    DynamicJsonDocument doc(2048);
+    JsonDocument doc(&jsonArena);
     JsonArray arr = doc.createNestedArray("chain");
     while (f.available())
     {
@@ -345,8 +685,8 @@ void handleGetImgChain(AsyncWebServerRequest *req)
         img.trim();
         if (img.length() > 0)
         {
-            // Add ".bmp" if not present
-            if (!img.endsWith(".bmp"))
+            // Older chain files store names without ".bmp"
+            if (img.lastIndexOf('.') < 0)
                 img += ".bmp";
             arr.add(img);
         }
@@ -365,7 +705,7 @@ void handleGetImgChain(AsyncWebServerRequest *req)
 // GET /api/listimg?contains=<FILTER>
 void handleListImages(AsyncWebServerRequest *req)
 {
-    File dir = SD.open("/images");
+    File dir = SDCard.open("/images");
     if (!dir)
     {
         req->send(500, "application/json", "{\"error\":\"failed to open /images\"}");
@@ -399,7 +739,7 @@ void handleListImages(AsyncWebServerRequest *req)
         lowerNm.toLowerCase();
         containsFilter.toLowerCase();
 
-        if (lowerNm.endsWith(".bmp") &&
+        if ((lowerNm.endsWith(".bmp") || lowerNm.endsWith(".png")) &&
             (containsFilter.isEmpty() || lowerNm.indexOf(containsFilter) != -1))
         {
             countTotalLength += nm.length();
@@ -432,35 +772,475 @@ void handleListImages(AsyncWebServerRequest *req)
     req->send(200, "application/json", res);
 }
 
-// Serve index.html
+// Serve index.html (from RAM, see StaticAssets)
 void handleGetIndex(AsyncWebServerRequest *req)
 {
-    if (!SD.exists("/index.html"))
-    {
+    if (!staticAssets.serve(req, "/index.html"))
         req->send(404, "text/plain", "no index");
-    }
-    else
-    {
-        req->send(SD, "/index.html", "text/html");
-    }
 }
 
 // GET /api/imgspec
 void handleGetSpec(AsyncWebServerRequest *req)
 {
-    DynamicJsonDocument doc(512);
+    JsonDocument doc(&jsonArena);
     doc["format"] = "BMP";
+    JsonArray formats = doc["formats"].to<JsonArray>();
+    formats.add("BMP");
+    formats.add("PNG");
     doc["colorspace"] = "sRGB";
     doc["width"] = config.width;
     doc["height"] = config.height;
     doc["bitDepth"] = 24;
     doc["compression"] = "none";
-    doc["maxSizeKB"] = 450;
+    JsonArray depths = doc["bitDepths"].to<JsonArray>();
+    for (int d : {1, 4, 8, 16, 24})
+        depths.add(d);
+    // Smallest upload that looks the same on the LEDs
+    JsonObject preferred = doc["preferred"].to<JsonObject>();
+    preferred["format"] = "BMP";
+    preferred["bitDepth"] = 8;
+    preferred["compression"] = "none";
+    doc["maxSizeKB"] = (MAX_IMG_BODY - 1024) * 3 / 4 / 1024; // base64 + JSON around it
+    String out;
+    serializeJson(doc, out);
+    req->send(200, "application/json", out);
+}
+
+// GET /api/stats
+void handleGetStats(AsyncWebServerRequest *req)
+{
+    const auto &st = driver->stats;
+    JsonDocument doc(&jsonArena);
+    doc["decoded"] = st.decoded;
+    doc["decodeSkipped"] = st.decodeSkipped;
+    doc["shown"] = st.shown;
+    doc["showSkipped"] = st.showSkipped;
+    doc["decodeUs"] = st.decodeMicros;
+    doc["showUs"] = st.showMicros;
+    doc["chainLength"] = chainLength;
+    doc["frameMs"] = frameDuration;
+    doc["configsApplied"] = configsApplied;
+    doc["configApplyMs"] = configApplyMs;
+    {
+        const auto &vs = validator->stats;
+        JsonObject ix = doc["imageIndex"].to<JsonObject>();
+        ix["ready"] = imageIndex.ready();
+        ix["images"] = imageIndex.size();
+        ix["scanMs"] = imageIndex.scanMs();
+        ix["jobs"] = vs.jobs;
+        ix["missingFrames"] = vs.missingFrames;
+        ix["busy"] = vs.busy;
+    }
+    {
+        JsonObject pw = doc["power"].to<JsonObject>();
+        pw["estimatedMa"] = driver->estimatedMa();
+        pw["budgetMa"] = driver->cfg.maxPowerMa;
+        pw["limit"] = driver->powerLimit() * 100 / 256; // % of brightness
+        pw["limited"] = st.powerLimited;
+    }
+    if (chainSync.currentRole() != SYNC_OFF)
+    {
+        const auto &ss = chainSync.stats;
+        JsonObject sy = doc["sync"].to<JsonObject>();
+        sy["role"] = chainSync.leading() ? "leader" : "follower";
+        sy["sent"] = ss.sent;
+        sy["received"] = ss.received;
+        sy["ignored"] = ss.ignored;
+        sy["slewed"] = ss.slewed;
+        sy["jumps"] = ss.jumps;
+        sy["errorMs"] = ss.errorMs;
+    }
+    if (fader.enabled())
+    {
+        const auto &cs = fader.stats;
+        JsonObject cf = doc["crossfade"].to<JsonObject>();
+        cf["fps"] = fader.outputFps();
+        cf["shown"] = cs.shown;
+        cf["blendUs"] = st.blendMicros;
+        cf["frameUs"] = cs.frameMicros;
+        cf["budgetUs"] = fader.interval() * 1000u;
+        cf["late"] = cs.late;
+    }
+    doc["freeHeap"] = ESP.getFreeHeap();
+    doc["sdMHz"] = SDCard.clockHz() / 1000000;
+    if (prefetch)
+    {
+        const auto &ps = prefetch->stats;
+        JsonObject pf = doc["prefetch"].to<JsonObject>();
+        pf["slots"] = prefetch->capacity();
+        pf["depth"] = prefetch->depth();
+        pf["minDepth"] = ps.minDepth;
+        pf["produced"] = ps.produced;
+        pf["consumed"] = ps.consumed;
+        pf["underruns"] = ps.underruns;
+        pf["failed"] = ps.failed;
+        pf["decodeUs"] = ps.decodeMicros;
+        pf["frameAllocs"] = ps.frameAllocs;
+    }
+    {
+        const auto &us = uploads->stats;
+        JsonObject up = doc["uploads"].to<JsonObject>();
+        up["active"] = uploads->active();
+        up["max"] = uploads->capacity();
+        up["accepted"] = us.accepted;
+        up["busy"] = us.busy;
+        up["tooLarge"] = us.tooLarge;
+    }
+    if (flashStore)
+    {
+        const auto &fs = flashStore->stats;
+        JsonObject fl = doc["flash"].to<JsonObject>();
+        fl["frames"] = flashStore->size();
+        fl["capacity"] = flashStore->capacity();
+        fl["hits"] = fs.hits;
+        fl["misses"] = fs.misses;
+        fl["mirrors"] = fs.mirrors;
+        fl["mirrorFailed"] = fs.mirrorFailed;
+        fl["mirrorMs"] = fs.mirrorMillis;
+        fl["busy"] = flashStore->busy();
+    }
+    {
+        const auto &cs = driver->composeStats();
+        JsonObject ly = doc["layers"].to<JsonObject>();
+        ly["overlays"] = driver->overlayCount();
+        ly["composed"] = cs.composed;
+        ly["composedPixels"] = cs.composedPixels;
+        ly["composeUs"] = cs.composeMicros;
+    }
+    if (effects.active())
+    {
+        JsonObject fx = doc["effect"].to<JsonObject>();
+        fx["name"] = effects.name();
+        fx["frames"] = effects.stats.frames;
+        fx["renderUs"] = effects.stats.renderMicros;
+        fx["renderFps"] = effects.stats.benchFps;
+    }
+    if (ticker.active())
+    {
+        JsonObject tx = doc["text"].to<JsonObject>();
+        tx["frames"] = ticker.stats.frames;
+        tx["renderUs"] = ticker.stats.renderMicros;
+        tx["glyphs"] = ticker.stats.glyphs;
+        tx["atlasBytes"] = ticker.stats.atlasBytes;
+    }
+    {
+        // frameAllocs / prefetch.frameAllocs stay 0 while a chain plays
+        JsonObject hp = doc["heap"].to<JsonObject>();
+        hp["free"] = ESP.getFreeHeap();
+        hp["minFree"] = ESP.getMinFreeHeap();
+        hp["maxAlloc"] = ESP.getMaxAllocHeap();
+        hp["allocs"] = heapAllocCount();
+        hp["loopAllocs"] = heapTaskAllocCount(HEAP_TASK_LOOP);
+        hp["frameAllocs"] = lastFrameAllocs;
+        hp["jsonArena"] = jsonArena.capacity();
+        hp["jsonArenaPeak"] = jsonArena.highWater;
+        hp["jsonFallbacks"] = jsonArena.fallbacks;
+    }
+#if DEBUG_MATRIX
+    {
+        JsonObject sm = doc["serialMirror"].to<JsonObject>();
+        sm["printed"] = driver->mirrorStats().printed;
+        sm["skipped"] = driver->mirrorStats().skipped;
+    }
+#endif
+    String out;
+    serializeJson(doc, out);
+    req->send(200, "application/json", out);
+}
+
+// POST /api/layer { "id":1, ?"file":"clock.bmp", ?"x":0, ?"y":0, ?"w":16, ?"h":8,
+//                   ?"alpha":255, ?"key":"000000", ?"z":0, ?"visible":true }
+// With "file" the image is decoded into overlay `id` (created if new, w/h
+// default to the matrix size); without it an existing overlay is only
+// moved / re-blended. Missing fields keep their current value.
+void handlePostLayer(AsyncWebServerRequest *req, uint8_t *data, size_t len)
+{
+    JsonDocument doc(&jsonArena);
+    if (deserializeJson(doc, data, len))
+    {
+        req->send(400, "application/json", "{\"error\":\"bad json\"}");
+        return;
+    }
+    uint8_t id = doc["id"] | 0;
+    if (!id)
+    {
+        req->send(400, "application/json", "{\"error\":\"missing id\"}");
+        return;
+    }
+    const char *file = doc["file"] | "";
+    LayerProps p;
+    bool exists = driver->overlay(id, p);
+    if (!exists && !*file)
+    {
+        req->send(404, "application/json", "{\"error\":\"no such layer\"}");
+        return;
+    }
+    p.x = doc["x"] | p.x;
+    p.y = doc["y"] | p.y;
+    p.w = doc["w"] | (*file ? 0 : p.w); // a new image is sized anew
+    p.h = doc["h"] | (*file ? 0 : p.h);
+    p.alpha = doc["alpha"] | p.alpha;
+    p.z = doc["z"] | p.z;
+    p.visible = doc["visible"] | p.visible;
+    // pixels of exactly this color are see-through
+    if (parseColor(doc["key"], p.key))
+        p.keyed = true;
+    else
+    {
+        // "key": null turns it off, a missing "key" leaves it as it is
+        for (JsonPairConst kv : doc.as<JsonObjectConst>())
+            if (kv.key() == "key")
+                p.keyed = false;
+    }
+
+    bool ok;
+    if (*file)
+    {
+        char path[IMAGE_PATH_MAX];
+        ok = imagePath(path, file) && driver->setOverlay(id, path, p);
+    }
+    else
+    {
+        ok = driver->setOverlay(id, p);
+    }
+    if (!ok)
+    {
+        req->send(400, "application/json", "{\"error\":\"bad image or too many layers\"}");
+        return;
+    }
+    // loop() pushes the change out
+    req->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// POST /api/text { "text":"Hello", ?"color":"FFFFFF", ?"bg":"000000", ?"scale":0,
+//                  ?"speed":20, ?"y":-1, ?"fps":30 }
+// Render text on the device instead of the chain: scrolling at `speed`
+// pixels per second (0 = static), `scale` x the 5x7 font (0 = fit height).
+void handlePostText(AsyncWebServerRequest *req, uint8_t *data, size_t len)
+{
+    JsonDocument doc(&jsonArena);
+    if (deserializeJson(doc, data, len))
+    {
+        req->send(400, "application/json", "{\"error\":\"bad json\"}");
+        return;
+    }
+    TextTicker::Style st;
+    parseColor(doc["color"], st.fg);
+    parseColor(doc["bg"], st.bg);
+    st.scale = doc["scale"] | 0;
+    st.speed = doc["speed"] | st.speed;
+    st.y = doc["y"] | st.y;
+    float fps = doc["fps"] | 30.0f;
+    if (fps <= 0)
+    {
+        req->send(400, "application/json", "{\"error\":\"invalid fps\"}");
+        return;
+    }
+
+    if (!ticker.set(doc["text"] | "", st, config.width, config.height))
+    {
+        req->send(400, "application/json", "{\"error\":\"empty or too long text\"}");
+        return;
+    }
+    // loop() stops the chain and starts the ticker
+    requestSwitch(SWITCH_TEXT, static_cast<uint16_t>(1000.0 / fps));
+    JsonDocument out(&jsonArena);
+    out["status"] = "ok";
+    out["glyphs"] = ticker.stats.glyphs;
+    out["atlasBytes"] = ticker.stats.atlasBytes;
+    String res;
+    serializeJson(out, res);
+    req->send(200, "application/json", res);
+}
+
+// DELETE /api/text
+void handleDeleteText(AsyncWebServerRequest *req)
+{
+    stopMode(SWITCH_TEXT);
+    req->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// POST /api/effect { "effect":"plasma", ?"speed":64, ?"scale":32, ?"color":"FF0000",
+//                    ?"color2":"0000FF", ?"angle":0, ?"fps":0 }
+// Effects: plasma, spiral, noise, fire, gradient, cycle. Computed per frame
+// instead of the chain; fps 0 = as fast as the LEDs take it. loop() measures
+// the render rate when it starts the effect, GET /api/stats reports it.
+void handlePostEffect(AsyncWebServerRequest *req, uint8_t *data, size_t len)
+{
+    JsonDocument doc(&jsonArena);
+    if (deserializeJson(doc, data, len))
+    {
+        req->send(400, "application/json", "{\"error\":\"bad json\"}");
+        return;
+    }
+    EffectId id = EffectEngine::byName(doc["effect"] | "");
+    if (id == EFFECT_COUNT)
+    {
+        req->send(400, "application/json", "{\"error\":\"unknown effect\"}");
+        return;
+    }
+    EffectEngine::Params p;
+    p.speed = doc["speed"] | p.speed;
+    p.scale = doc["scale"] | p.scale;
+    p.angle = doc["angle"] | p.angle;
+    parseColor(doc["color"], p.color);
+    parseColor(doc["color2"], p.color2);
+    float fps = doc["fps"] | 0.0f;
+
+    if (!effects.set(id, p, config.width, config.height))
+    {
+        req->send(400, "application/json", "{\"error\":\"no matrix\"}");
+        return;
+    }
+    // loop() stops the chain and starts the effect
+    requestSwitch(SWITCH_EFFECT, fps > 0 ? static_cast<uint16_t>(1000.0 / fps) : 1);
+
+    JsonDocument out(&jsonArena);
+    out["status"] = "ok";
+    out["effect"] = effects.name();
+    out["width"] = config.width;
+    out["height"] = config.height;
+    String res;
+    serializeJson(out, res);
+    req->send(200, "application/json", res);
+}
+
+// DELETE /api/effect
+void handleDeleteEffect(AsyncWebServerRequest *req)
+{
+    stopMode(SWITCH_EFFECT);
+    req->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// DELETE /api/layer?id=<ID>
+void handleDeleteLayer(AsyncWebServerRequest *req)
+{
+    if (!req->hasParam("id"))
+    {
+        req->send(400, "application/json", "{\"error\":\"missing id\"}");
+        return;
+    }
+    if (!driver->removeOverlay(req->getParam("id")->value().toInt()))
+    {
+        req->send(404, "application/json", "{\"error\":\"no such layer\"}");
+        return;
+    }
+    req->send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// ——— Swap in a validated config without rebooting ———
+// The web task only checks the config and stages a copy; loop() builds the
+// new output and LED map at the top of its next pass, between two frames,
+// and restarts the running chain on the new layout. The upload pool belongs
+// to the web task and takes a new http.maxUploads right away. Wi-Fi / AP
+// changes still need a reboot.
+SemaphoreHandle_t configLock = xSemaphoreCreateMutex();
+ConfigReader *stagedConfig = nullptr; // newest wins; configLock also guards config's Strings
+
+void applyConfig(AsyncWebServerRequest *req, ConfigReader &next)
+{
+    if (!next.validate())
+    {
+        req->send(400, "application/json", "{\"error\":\"" + next.error + "\"}");
+        return;
+    }
+    uploads->resize(next.maxUploads);
+    jsonArena.begin(size_t(next.jsonArenaKB) * 1024); // no document is alive here
+    ConfigReader *staged = new ConfigReader(next);
+    bool restartRequired;
+    {
+        LockGuard g(configLock);
+        restartRequired = !next.sameNetwork(config);
+        delete stagedConfig;
+        stagedConfig = staged;
+    }
+
+    JsonDocument doc(&jsonArena);
+    doc["status"] = "ok";
+    doc["width"] = next.width;
+    doc["height"] = next.height;
+    doc["panels"] = next.panels.size();
+    doc["leds"] = next.stripLen;
+    doc["restartRequired"] = restartRequired;
     String out;
     serializeJson(doc, out);
     req->send(200, "application/json", out);
 }
 
+// loop(): switch to a config staged by applyConfig()
+bool takeStagedConfig()
+{
+    ConfigReader *next;
+    {
+        LockGuard g(configLock);
+        next = stagedConfig;
+        stagedConfig = nullptr;
+    }
+    if (!next)
+        return false;
+    uint32_t t0 = millis();
+    if (prefetch)
+        prefetch->stop();
+    {
+        LockGuard g(configLock); // copies next into config
+        driver->reconfigure(*next);
+    }
+    delete next;
+    if (prefetch)
+        prefetch->resize(config.prefetchFrames);
+    else if (config.prefetchFrames)
+        prefetch = new FramePrefetcher(*driver, config.prefetchFrames, flashStore);
+    if (flashStore)
+        flashStore->resize();
+    ticker.resize(config.width, config.height);
+    effects.resize(config.width, config.height);
+    fader.resize(driver->frame.size(), config.crossfadeFps);
+    chainSync.begin(config.syncRole, config.syncPort);
+    startChain();
+    configsApplied++;
+    configApplyMs = millis() - t0;
+    Serial.printf("⚙️ Config applied in %u ms\n", unsigned(configApplyMs));
+    return true;
+}
+
+// POST /api/config <config.json> — validate, store on SD (old one kept as .bak), apply
+void handlePostConfig(AsyncWebServerRequest *req, uint8_t *data, size_t len)
+{
+    ConfigReader next;
+    if (!next.loadFromBuffer(data, len) || !next.validate())
+    {
+        req->send(400, "application/json", "{\"error\":\"" + next.error + "\"}");
+        return;
+    }
+
+    String backup = String(CONFIG_PATH) + ".bak";
+    if (SDCard.exists(CONFIG_PATH))
+    {
+        SDCard.remove(backup);
+        SDCard.rename(CONFIG_PATH, backup);
+    }
+    File f = SDCard.open(CONFIG_PATH, FILE_WRITE);
+    if (!f || f.write(data, len) != len)
+    {
+        req->send(500, "application/json", "{\"error\":\"fs write config\"}");
+        return;
+    }
+    f.close();
+    applyConfig(req, next);
+}
+
+// POST /api/config/reload — re-read config.json from SD
+void handleReloadConfig(AsyncWebServerRequest *req)
+{
+    ConfigReader next;
+    if (!next.load(CONFIG_PATH))
+    {
+        req->send(400, "application/json", "{\"error\":\"" + next.error + "\"}");
+        return;
+    }
+    applyConfig(req, next);
+}
+
 // ====== AP-mode Server Setup ======
 void setUpAPServer()
 {
@@ -473,13 +1253,11 @@ void setUpAPServer()
 void setUpAPIServer()
 {
     // Redirect common captive portal checks to index.html
-    server.on("/index.html", HTTP_ANY, [](AsyncWebServerRequest *req)
+    server.on("/index.html", HTTP_ANY, handleGetIndex);
+    server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *req)
               {
-      if (SD.exists("/index.html")) {
-        req->send(SD, "/index.html", "text/html");
-      } else {
-        req->send(404, "text/plain", "Missing index.html");
-      } });
+      if (!staticAssets.serve(req, "/favicon.ico"))
+        req->send(404); });
     // Brightness Slider
     server.on("/api/brightness", HTTP_POST, [](AsyncWebServerRequest *request) {},
               NULL, // No upload handler
@@ -495,54 +1273,69 @@ void setUpAPIServer()
               /* onUpload   */ nullptr,
               /* onBody     */ [](AsyncWebServerRequest *req, uint8_t *data, size_t len, size_t index, size_t total)
               {
-        static String bodyBuffer;
-
-        // Start of a new upload?
-        if (index == 0)
+        // Complete once the last chunk is in
+        if (auto *body = uploads->collect(req, data, len, index, total, MAX_IMG_BODY))
         {
-            bodyBuffer = "";
-        }
-
-        // Append this chunk
-        bodyBuffer += String((char *)data).substring(0, len);
-
-        // If this is the last chunk…
-        if (index + len == total)
-        {
-            handlePostImageComplete(req, bodyBuffer);
+            handlePostImageComplete(req, body->data(), body->size());
+            uploads->release(req);
         } });
     server.on("/api/display", HTTP_POST, [](AsyncWebServerRequest *request) {}, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
               {
-                  static std::vector<uint8_t> buffer;
-                  if (total > 6966) // this is the size of a 48x48 24bit color bmp as produced by ffmpeg
-                  {
-                      return;
-                  }
-                  buffer.resize(total);
-                  std::copy_n(data, len, buffer.data()+index);
-                  if (index+len == total) {
-                      driver->drawBMP(make_virtual_file(buffer.data(), buffer.size()));
-                      buffer.clear();
-                      request->send(204);
+                  if (auto *body = uploads->collect(request, data, len, index, total, MAX_DISPLAY_BODY)) {
+                      if (driver->drawImage(make_virtual_file(body->data(), body->size())))
+                          request->send(204);
+                      else
+                          request->send(400, "application/json", "{\"error\":\"bad image\"}");
+                      uploads->release(request);
+                  } });
+    server.on("/api/region", HTTP_POST, [](AsyncWebServerRequest *request) {}, nullptr, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+                  if (auto *body = uploads->collect(request, data, len, index, total, MAX_DISPLAY_BODY)) {
+                      if (drawRegionPacket(body->data(), body->size()))
+                          request->send(204);
+                      else
+                          request->send(400, "application/json", "{\"error\":\"bad region\"}");
+                      uploads->release(request);
                   } });
     server.on("/api/imgchain", HTTP_GET, handleGetImgChain);
     server.on("/api/imgchain", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
               {
-            static std::vector<uint8_t> bodyBuffer;
-            if (index == 0) {
-                bodyBuffer.clear();
-                bodyBuffer.reserve(total);
-            }
-            // Append this chunk
-            bodyBuffer.insert(bodyBuffer.end(), data, data + len);
-
-            // If this is the last chunk…
-            if (index + len == total) {
-                handlePostImgChain(request, bodyBuffer.data(), bodyBuffer.size());
-                bodyBuffer.clear();
+            if (auto *body = uploads->collect(request, data, len, index, total, MAX_JSON_BODY)) {
+                handlePostImgChain(request, body->data(), body->size());
+                uploads->release(request);
             } });
     server.on("/api/listimg", HTTP_GET, handleListImages);
     server.on("/api/imgspec", HTTP_GET, handleGetSpec);
+    server.on("/api/stats", HTTP_GET, handleGetStats);
+    server.on("/api/framebuffer", HTTP_GET, handleGetFramebuffer);
+    server.on("/api/effect", HTTP_DELETE, handleDeleteEffect);
+    server.on("/api/effect", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            if (auto *body = uploads->collect(request, data, len, index, total, MAX_JSON_BODY)) {
+                handlePostEffect(request, body->data(), body->size());
+                uploads->release(request);
+            } });
+    server.on("/api/text", HTTP_DELETE, handleDeleteText);
+    server.on("/api/text", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            if (auto *body = uploads->collect(request, data, len, index, total, MAX_JSON_BODY)) {
+                handlePostText(request, body->data(), body->size());
+                uploads->release(request);
+            } });
+    server.on("/api/layer", HTTP_DELETE, handleDeleteLayer);
+    server.on("/api/layer", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            if (auto *body = uploads->collect(request, data, len, index, total, MAX_JSON_BODY)) {
+                handlePostLayer(request, body->data(), body->size());
+                uploads->release(request);
+            } });
+    server.on("/api/config/reload", HTTP_POST, handleReloadConfig);
+    server.on("/api/config", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+              {
+            if (auto *body = uploads->collect(request, data, len, index, total, MAX_CONFIG_BODY)) {
+                handlePostConfig(request, body->data(), body->size());
+                uploads->release(request);
+            } });
     server.on("/", HTTP_GET, handleGetIndex);
     server.begin();
 }
@@ -552,6 +1345,7 @@ void setup()
 {
     Serial.begin(115200);
     Serial.println("Starting up…");
+    heapTrackTask(HEAP_TASK_LOOP, xTaskGetCurrentTaskHandle());
     // — Load JSON config, init Wi-Fi & SD
     if (!config.loadFromSD(CONFIG_PATH))
     {
@@ -559,6 +1353,7 @@ void setup()
         for (;;)
             delay(1000);
     }
+    jsonArena.begin(size_t(config.jsonArenaKB) * 1024);
     config.beginWiFi();
 
     // Check if we are connected to Wi-Fi
@@ -573,11 +1368,36 @@ void setup()
 
     driver = new MatrixDriver(config);
     driver->begin();
-    if (!SD.exists("/images"))
-        SD.mkdir("/images");
-    if (!SD.exists("/imgchain"))
-        SD.mkdir("/imgchain");
+    fader.resize(driver->frame.size(), config.crossfadeFps);
+    flashStore = new FlashFrameStore(*driver);
+    if (!flashStore->begin())
+    {
+        delete flashStore;
+        flashStore = nullptr;
+    }
+    if (config.prefetchFrames)
+        prefetch = new FramePrefetcher(*driver, config.prefetchFrames, flashStore);
+    validator = new ChainValidator(imageIndex, flashStore);
+    if (!SDCard.exists("/images"))
+        SDCard.mkdir("/images");
+    if (!SDCard.exists("/imgchain"))
+        SDCard.mkdir("/imgchain");
+    staticAssets.load("/index.html", "text/html");
+    staticAssets.load("/favicon.ico", "image/x-icon");
+
+    // Resume the chain kept in flash; config.json still has to load from SD first
+    if (flashStore)
+    {
+        chainLength = flashStore->cachedChain(imageChain, MAX_CHAIN, frameDuration);
+        if (chainLength)
+        {
+            Serial.printf("Playing %u frames from flash\n", chainLength);
+            startChain();
+        }
+    }
 
+    uploads = new UploadPool(config.maxUploads);
+    chainSync.begin(config.syncRole, config.syncPort);
     setUpAPIServer();
 }
 
@@ -592,33 +1412,98 @@ void loop()
         dnsServer.processNextRequest();
     }
 
-    if (chainLength == 0)
+    takeStagedConfig();
+
+    // brightness / overlay changes, only the area they touched is redrawn
+    if (driver->refreshPending)
+        driver->update();
+
+    takeValidatedChain();
+    takeModeSwitch();
+
+    // Effect / text ticker: one rendered frame per frameDuration, static
+    // text is only drawn once
+    if (effects.active() || ticker.active())
+    {
+        unsigned long now = millis();
+        unsigned long elapsed = now - lastUpdate;
+        if (elapsed < frameDuration)
+        {
+            delay(std::min<unsigned long>(frameDuration - elapsed, IDLE_SLEEP_MS));
+            return;
+        }
+        lastUpdate = now;
+        if (effects.active())
+            effects.show(*driver, now);
+        else
+            ticker.show(*driver, now);
+        return;
+    }
+
+    // Nothing animating: a static image stays on the LEDs without redraws,
+    // sleep instead of spinning
+    if (imagesSeen != imagesWritten)
+    {
+        imagesSeen = imagesWritten;
+        chainIdle = false;
+    }
+    if (chainLength == 0 || chainIdle)
+    {
+        delay(IDLE_SLEEP_MS);
+        return;
+    }
+
+    if (chainSync.following())
+        followSync(millis());
+    else if (chainSync.leading() && frameDuration)
+        chainSync.announce(millis(), chainPosition(millis()), chainLength, frameDuration);
+
+    if (fader.enabled() && chainLength > 1)
+    {
+        stepCrossfade();
         return;
+    }
 
     unsigned long now = millis();
-    if (now - lastUpdate >= frameDuration)
+    unsigned long elapsed = now - lastUpdate;
+    if (elapsed < frameDuration)
     {
+        delay(std::min<unsigned long>(frameDuration - elapsed, IDLE_SLEEP_MS));
+        return;
+    }
+
+    // Read-ahead playback: only take decoded frames out of the ring. If the
+    // producer is behind, poll again without moving lastUpdate.
+    if (prefetch && prefetch->active())
+    {
+        uint8_t index;
+        const uint8_t *fb = prefetch->front(index);
+        if (!fb)
+        {
+            delay(1);
+            return;
+        }
+        uint32_t a0 = heapTaskAllocCount(HEAP_TASK_LOOP);
         lastUpdate = now;
+        driver->showFrame(fb, prefetch->frameSize());
+        prefetch->pop();
+        advanceFrame((index + 1) % chainLength);
+        lastFrameAllocs = heapTaskAllocCount(HEAP_TASK_LOOP) - a0;
+        return;
+    }
+
+    lastUpdate = now;
 #ifdef DEBUG
-        Serial.printf("Frame %u of %u\n", currentFrame + 1, chainLength);
+    Serial.printf("Frame %u of %u\n", currentFrame + 1, chainLength);
 #endif
+    uint32_t a0 = heapTaskAllocCount(HEAP_TASK_LOOP);
 
-        // draw current frame
-        String fn = imageChain[currentFrame];
-        if (fn.length())
-        {
-            String path = "/images/" + fn + ".bmp";
-            if (SD.exists(path))
-            {
-                driver->drawBMP(path.c_str());
-            }
-            else
-            {
-                Serial.printf("❌ File not found: %s\n", path.c_str());
-            }
-        }
+    // draw current frame (skipped inside drawImage if it is already on screen)
+    bool drawn = showChainFrame(currentFrame);
 
-        // step to next, wrap at chainLength
-        currentFrame = (currentFrame + 1) % chainLength;
-    }
+    chainIdle = drawn && chainLength == 1;
+
+    // step to next, wrap at chainLength
+    advanceFrame((currentFrame + 1) % chainLength);
+    lastFrameAllocs = heapTaskAllocCount(HEAP_TASK_LOOP) - a0;
 }
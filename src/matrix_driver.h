@@ -3,35 +3,559 @@
 
 #include <Arduino.h>
 #include <SPI.h>
-#include <SD.h>
-#include <Adafruit_NeoPixel.h>
+#include "sd_storage.h"
+#include "virtual_file.h"
 #include "config.h"
-#define min(a, b) ((a) < (b) ? (a) : (b))
+#include "led_output.h"
+#include "compositor.h"
+#if DEBUG_MATRIX
+#include "serial_mirror.h"
+#endif
+#include <PNGdec.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+// Scoped hold of a FreeRTOS mutex
+class LockGuard
+{
+public:
+    LockGuard(SemaphoreHandle_t m) : m(m) { xSemaphoreTake(m, portMAX_DELAY); }
+    ~LockGuard() { xSemaphoreGive(m); }
 
-// ——— Drives WS2812 strip & renders BMPs ———
+private:
+    SemaphoreHandle_t m;
+};
+
+// ——— Drives the LED output & renders BMPs ———
+// Drawing goes into an RGB888 framebuffer (cfg.width x cfg.height); show()
+// runs the color-order blit kernel through the precomputed (x,y) → LED map
+// and pushes the wire buffer out. Overlay layers (setOverlay()) are
+// composited over the framebuffer on the way out; only the area marked
+// dirty since the last transfer is composited and blitted.
+// Two locks allow decoding on one task while another shows: decodeLock
+// guards the decoder state, showLock the framebuffer and the output.
+// When both are needed decodeLock is taken first.
 class MatrixDriver
 {
 public:
     ConfigReader &cfg;
-    Adafruit_NeoPixel strip;
+    LedOutput *output;
     int brightness = 255;
+    std::vector<uint8_t> frame;  // RGB888, row-major
+    std::vector<int32_t> ledMap; // (x,y) → LED index, -1 if unmapped
+    BlitFn blit;                 // packing kernel for cfg.order
 
-    MatrixDriver(ConfigReader &c)
-        : cfg(c), strip(c.stripLen, c.pin, NEO_GRB + NEO_KHZ800) {}
+    // Frame/transfer counters for /api/stats
+    struct RenderStats
+    {
+        uint32_t decoded = 0;       // images decoded into the framebuffer
+        uint32_t decodeSkipped = 0; // same source as on screen, not decoded again
+        uint32_t shown = 0;         // wire transfers
+        uint32_t showSkipped = 0;   // framebuffer unchanged, transfer skipped
+        uint32_t decodeMicros = 0;  // last decode
+        uint32_t showMicros = 0;    // last blit + transfer
+        uint32_t blendMicros = 0;   // last crossfade blend (showBlend())
+        uint32_t powerLimited = 0;  // transfers dimmed to stay within cfg.maxPowerMa
+    } stats;
 
-    void debugPrintMatrix();
+    // Set from other tasks (e.g. brightness change) to have loop() call update()
+    volatile bool refreshPending = false;
+
+    MatrixDriver(ConfigReader &c)
+        : cfg(c),
+          output(makeLedOutput(c.ledType, c.stripLen, c.pin, c.clockPin, c.spiKHz)),
+          blit(blitKernelFor(c.order)),
+          decodeLock(xSemaphoreCreateMutex()),
+          showLock(xSemaphoreCreateMutex()) {}
+    ~MatrixDriver()
+    {
+        delete output;
+        delete png;
+        vSemaphoreDelete(decodeLock);
+        vSemaphoreDelete(showLock);
+    }
 
     void begin()
     {
-        strip.begin();
-        strip.show();
+        frame.assign(size_t(cfg.width) * cfg.height * 3, 0);
+        buildLedMap(cfg, output->count, ledMap);
+        reserveScratch();
+        layers.resize(cfg.width, cfg.height);
+        setTarget(frame.data(), cfg.width, cfg.height);
+        output->begin();
+        output->show();
+        resetPower();
+        shownValid = false;
+        dirty = layers.bounds();
+#if DEBUG_MATRIX
+        mirror.begin();
+        debugPrintMapping();
+#endif
+    }
+
+    // Switch to new settings without a reboot. The output and LED map are
+    // built first on the calling task; the swap itself happens between two
+    // frames under both locks. `next` is copied into cfg.
+    void reconfigure(ConfigReader &next)
+    {
+        LedOutput *nextOutput = makeLedOutput(next.ledType, next.stripLen, next.pin, next.clockPin, next.spiKHz);
+        std::vector<int32_t> nextMap;
+        buildLedMap(next, nextOutput->count, nextMap);
+        std::vector<uint8_t> nextFrame(size_t(next.width) * next.height * 3, 0);
+        BlitFn nextBlit = blitKernelFor(next.order);
+
+        LockGuard d(decodeLock);
+        LockGuard g(showLock);
+        // the old output releases its pin / bus before the new one claims it
+        delete output;
+        output = nextOutput;
+        ledMap.swap(nextMap);
+        frame.swap(nextFrame);
+        blit = nextBlit;
+        cfg = next;
+        setTarget(frame.data(), cfg.width, cfg.height);
+        reserveScratch();
+        layers.resize(cfg.width, cfg.height);
+        srcWidth = srcHeight = 0; // scale tables are per matrix size
+        shownSource[0] = 0;
+        shownValid = false;
+        dirty = layers.bounds();
+        output->begin();
+        output->show();
+        resetPower();
+#if DEBUG_MATRIX
+        debugPrintMapping();
+#endif
+    }
+
+    void clear() { std::fill(frame.begin(), frame.end(), 0); }
+
+    // Blit + transfer of the whole framebuffer (after drawing into it
+    // directly), unless it and brightness are exactly what the LEDs already
+    // show. Returns true if the strip was refreshed.
+    bool show()
+    {
+        LockGuard g(showLock);
+        dirty = layers.bounds();
+        return refresh();
+    }
+
+    // Transfer what changed since the last one (overlays, brightness)
+    bool update()
+    {
+        LockGuard g(showLock);
+        return refresh();
+    }
+
+    // Show a finished framebuffer (e.g. from the prefetch ring). Ignored if
+    // it was made for another matrix size (see reconfigure()).
+    bool showFrame(const uint8_t *fb, size_t bytes)
+    {
+        LockGuard g(showLock);
+        if (bytes != frame.size())
+            return false;
+        memcpy(frame.data(), fb, frame.size());
+        shownSource[0] = 0;
+        dirty = layers.bounds();
+        return refresh();
+    }
+
+    // Show a crossfade of two finished framebuffers: a where t = 0, b
+    // where t = 256. Ignored like showFrame() if they don't fit.
+    bool showBlend(const uint8_t *a, const uint8_t *b, size_t bytes, uint16_t t)
+    {
+        LockGuard g(showLock);
+        if (bytes != frame.size())
+            return false;
+        uint32_t t0 = micros();
+        blendFrames(frame.data(), a, b, bytes, std::min<uint16_t>(t, 256));
+        stats.blendMicros = micros() - t0;
+        shownSource[0] = 0;
+        dirty = layers.bounds();
+        return refresh();
+    }
+
+    // Next drawImage(filename) decodes even if it names the image on screen
+    // (call when that file was overwritten).
+    void forgetSource()
+    {
+        LockGuard g(showLock);
+        shownSource[0] = 0;
+    }
+
+    // Draw an image (BMP or PNG, picked by magic bytes) from any File
+    bool drawImage(File f)
+    {
+        LockGuard d(decodeLock);
+        LockGuard g(showLock);
+        shownSource[0] = 0;
+        setTarget(frame.data(), cfg.width, cfg.height);
+        if (!decodeImage(f))
+            return false;
+        present();
+        return true;
+    }
+
+    // Draw an image file from SD. Re-drawing the file already on screen is a
+    // no-op.
+    bool drawImage(const char *filename)
+    {
+        LockGuard d(decodeLock);
+        LockGuard g(showLock);
+        if (!strcmp(shownSource, filename))
+        {
+            stats.decodeSkipped++;
+            return true;
+        }
+        shownSource[0] = 0;
+        setTarget(frame.data(), cfg.width, cfg.height);
+        if (!decodeFile(filename))
+            return false;
+        strlcpy(shownSource, filename, sizeof(shownSource));
+        present();
+        return true;
+    }
+
+    // Decode an image file from SD into a caller-owned framebuffer without
+    // touching what is on screen. Fails if dstBytes is not (or no longer,
+    // after reconfigure()) frame.size().
+    bool decodeInto(const char *filename, uint8_t *dst, size_t dstBytes)
+    {
+        LockGuard d(decodeLock);
+        if (dstBytes != frame.size())
+            return false;
+        setTarget(dst, cfg.width, cfg.height);
+        bool ok = decodeFile(filename);
+        setTarget(frame.data(), cfg.width, cfg.height);
+        return ok;
+    }
+
+    // ——— Partial frames ———
+    // Write w x h RGB888 pixels with the top-left at (x, y) into the
+    // framebuffer and transfer just that area; what falls off the matrix is
+    // dropped. False if `bytes` isn't w * h * 3.
+    bool drawRegion(int16_t x, int16_t y, uint16_t w, uint16_t h, const uint8_t *px, size_t bytes)
+    {
+        if (bytes != size_t(w) * h * 3)
+            return false;
+        LockGuard g(showLock);
+        Rect r(std::max<int>(x, 0), std::max<int>(y, 0),
+               std::min<int>(x + w, cfg.width), std::min<int>(y + h, cfg.height));
+        if (r.empty())
+            return true;
+        size_t span = size_t(r.x1 - r.x0) * 3;
+        for (int row = r.y0; row < r.y1; row++)
+            memcpy(&frame[(size_t(row) * cfg.width + r.x0) * 3],
+                   px + (size_t(row - y) * w + (r.x0 - x)) * 3, span);
+        shownSource[0] = 0;
+        dirty = dirty | r;
+        refresh();
+        return true;
+    }
+
+    // ——— Overlays ———
+    // Decode an image file into overlay layer `id`, scaled to p.w x p.h
+    // (0 = matrix size). Replaces the layer if it exists; shown by the next
+    // update(). False if the image can't be decoded or all layers are taken.
+    bool setOverlay(uint8_t id, const char *filename, LayerProps p)
+    {
+        LockGuard d(decodeLock);
+        if (!p.w || !p.h)
+        {
+            p.w = cfg.width;
+            p.h = cfg.height;
+        }
+        if (size_t(p.w) * p.h > frame.size() / 3)
+            return false; // no larger than the matrix
+        std::vector<uint8_t> px(size_t(p.w) * p.h * 3);
+        setTarget(px.data(), p.w, p.h);
+        bool ok = decodeFile(filename);
+        setTarget(frame.data(), cfg.width, cfg.height);
+        if (!ok)
+            return false;
+        LockGuard g(showLock);
+        return changeLayer(id, p, &px);
+    }
+
+    // Move / re-blend an existing overlay without new pixels; p.w and p.h
+    // must stay the same
+    bool setOverlay(uint8_t id, const LayerProps &p)
+    {
+        LockGuard g(showLock);
+        return changeLayer(id, p, nullptr);
+    }
+
+    bool overlay(uint8_t id, LayerProps &p)
+    {
+        LockGuard g(showLock);
+        return layers.get(id, p);
+    }
+
+    bool removeOverlay(uint8_t id)
+    {
+        LockGuard g(showLock);
+        Rect r = layers.remove(id);
+        dirty = dirty | r;
+        refreshPending = true;
+        return !r.empty();
+    }
+
+    // Copy of the frame as composed for the LEDs (before brightness) into
+    // `out`, resized to w * h * 3
+    void snapshot(std::vector<uint8_t> &out, uint16_t &w, uint16_t &h)
+    {
+        LockGuard g(showLock);
+        w = cfg.width;
+        h = cfg.height;
+        const uint8_t *src = layers.empty() ? frame.data() : layers.output();
+        out.assign(src, src + frame.size());
+    }
+
+    // Current draw of the LEDs as they are lit now, estimated from the color
+    // bytes on the wire: LED_IDLE_MA per LED plus cfg.ledMa per full white
+    uint32_t estimatedMa() const
+    {
+        return uint32_t(output->count) * LED_IDLE_MA + uint64_t(wireSum) * cfg.ledMa / 765;
     }
-    void show() { strip.show(); }
 
-    // Map (x,y) → global LED index
+    // Factor the power limiter applies to brightness, / 256
+    uint16_t powerLimit() const { return limit; }
+
+    uint8_t overlayCount() const { return layers.size(); }
+    const Compositor::Stats &composeStats() const { return layers.stats; }
+
+private:
+    static const uint8_t LED_IDLE_MA = 1; // WS2812 class LEDs, all off
+
+    // Framebuffer locked: compose and blit the dirty area, push it out
+    // unless nothing changed. A full refresh is skipped if the result
+    // hashes like what the LEDs already show.
+    bool refresh()
+    {
+        refreshPending = false;
+        uint16_t scale = outputScale();
+        Rect r = scale != shownScale ? layers.bounds() : dirty;
+        dirty = Rect();
+        if (r.empty())
+        {
+            stats.showSkipped++;
+            return false;
+        }
+        const uint8_t *src = frame.data();
+        if (!layers.empty())
+        {
+            layers.compose(frame.data(), r);
+            src = layers.output();
+        }
+        uint8_t *wire = output->pixels + output->lead;
+        uint32_t t0 = micros();
+        if (r == layers.bounds())
+        {
+            uint32_t h = fnv1a(src, frame.size());
+            if (shownValid && scale == shownScale && h == shownHash)
+            {
+                stats.showSkipped++;
+                return false;
+            }
+            t0 = micros();
+            wireSum += blit(src, ledMap.data(), ledMap.size(), wire, output->stride, scale);
+            shownHash = h;
+            shownValid = true;
+        }
+        else
+        {
+            // the hash no longer describes the whole frame on the LEDs
+            shownValid = false;
+            for (int y = r.y0; y < r.y1; y++)
+            {
+                size_t i = size_t(y) * cfg.width + r.x0;
+                wireSum += blit(src + i * 3, ledMap.data() + i, r.x1 - r.x0, wire, output->stride, scale);
+            }
+        }
+        if (limitPower(scale))
+        {
+            // over budget: dim the whole strip before it goes out (again if
+            // rounding left it just above)
+            do
+            {
+                scale = outputScale();
+                wireSum += blit(src, ledMap.data(), ledMap.size(), wire, output->stride, scale);
+            } while (limitPower(scale));
+            shownHash = fnv1a(src, frame.size());
+            shownValid = true;
+            stats.powerLimited++;
+        }
+        output->show();
+        shownScale = scale;
+        stats.shown++;
+        stats.showMicros = micros() - t0;
+#if DEBUG_MATRIX
+        mirror.offer(src, cfg.width, cfg.height);
+#endif
+        return true;
+    }
+
+    // brightness with the power limiter's factor applied
+    uint16_t outputScale() const { return ((uint16_t(brightness) + 1) * limit) >> 8; }
+
+    // Sum of color bytes the output may carry within cfg.maxPowerMa
+    uint32_t powerBudget() const
+    {
+        if (!cfg.maxPowerMa)
+            return UINT32_MAX;
+        uint32_t idle = uint32_t(output->count) * LED_IDLE_MA;
+        return cfg.maxPowerMa > idle ? uint64_t(cfg.maxPowerMa - idle) * 765 / cfg.ledMa : 0;
+    }
+
+    // After a blit at `scale`: adjust the limiter factor so the frame fits
+    // the budget. True if it was over and has to be blitted again, dimmer;
+    // if it became darker the limit is lifted on the next update().
+    bool limitPower(uint16_t scale)
+    {
+        uint32_t budget = powerBudget();
+        uint32_t full = uint32_t(brightness) + 1;
+        if (wireSum > budget)
+        {
+            // the estimate scales linearly with the blit scale
+            uint32_t fit = uint64_t(scale) * budget / wireSum;
+            limit = fit * 256 / full;
+            return true;
+        }
+        if (limit < 256)
+        {
+            uint32_t fit = wireSum ? std::min<uint64_t>(uint64_t(scale) * budget / wireSum, 256) : 256;
+            uint32_t next = std::min<uint32_t>(fit * 256 / full, 256);
+            if (next > limit + 8u) // some hysteresis, don't refresh for every small step
+            {
+                limit = next;
+                refreshPending = true;
+            }
+        }
+        return false;
+    }
+
+    // The output was (re)started: its color bytes are all 0
+    void resetPower()
+    {
+        wireSum = 0;
+        limit = 256;
+    }
+
+    // Both locks held, target == frame: show a freshly decoded image
+    void present()
+    {
+        dirty = layers.bounds();
+        refresh();
+    }
+
+    // d = (a * (256 - t) + b * t) / 256 per byte, two channels per 32-bit
+    // multiply (each lane's product stays below 2^16)
+    static void blendFrames(uint8_t *d, const uint8_t *a, const uint8_t *b, size_t n, uint16_t t)
+    {
+        uint32_t it = 256 - t;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            uint32_t x, y;
+            memcpy(&x, a + i, 4);
+            memcpy(&y, b + i, 4);
+            uint32_t lo = (((x & 0x00FF00FF) * it + (y & 0x00FF00FF) * t) >> 8) & 0x00FF00FF;
+            uint32_t hi = (((x >> 8) & 0x00FF00FF) * it + ((y >> 8) & 0x00FF00FF) * t) & 0xFF00FF00;
+            x = lo | hi;
+            memcpy(d + i, &x, 4);
+        }
+        for (; i < n; i++)
+            d[i] = (a[i] * it + b[i] * t) >> 8;
+    }
+
+    // showLock held: apply a layer change and mark the area it touched
+    bool changeLayer(uint8_t id, const LayerProps &p, std::vector<uint8_t> *px)
+    {
+        Rect r;
+        if (!layers.set(id, p, px, r))
+            return false;
+        dirty = dirty | r;
+        refreshPending = true;
+        return true;
+    }
+
+    // Where the decoders write, and at which size
+    void setTarget(uint8_t *buf, uint16_t w, uint16_t h)
+    {
+        target = buf;
+        dstW = w;
+        dstH = h;
+    }
+
+public:
+    // Framebuffer (x,y) → global LED index, -1 if not shown
     int xyToIndex(uint16_t x, uint16_t y)
     {
-        if (x >= cfg.width || y >= cfg.height)
+        return x < cfg.width && y < cfg.height ? ledMap[size_t(y) * cfg.width + x] : -1;
+    }
+
+    // Framebuffer → LED table for `c` (transform and panel layout, LEDs
+    // past `count` unmapped), so a frame costs one lookup per pixel. Taken
+    // from the config cache when it came with one, else built and cached.
+    static void buildLedMap(ConfigReader &c, uint16_t count, std::vector<int32_t> &map)
+    {
+        if (c.ledMap.size() == size_t(c.width) * c.height)
+        {
+            map.swap(c.ledMap);
+            return;
+        }
+        map.resize(size_t(c.width) * c.height);
+        for (uint16_t y = 0; y < c.height; y++)
+        {
+            for (uint16_t x = 0; x < c.width; x++)
+            {
+                uint16_t mx, my;
+                int i = contentToMatrix(c, x, y, mx, my) ? xyToIndex(c, mx, my) : -1;
+                map[size_t(y) * c.width + x] = (i < count) ? i : -1;
+            }
+        }
+        c.saveCache(map);
+    }
+
+    // Framebuffer (x,y) → panel coordinates through c's transform: viewport
+    // offset, mirroring, then clockwise rotation. False if outside the view.
+    static bool contentToMatrix(const ConfigReader &c, uint16_t x, uint16_t y, uint16_t &mx, uint16_t &my)
+    {
+        bool quarter = c.rotate == 90 || c.rotate == 270;
+        int32_t vw = quarter ? c.matrixHeight : c.matrixWidth;
+        int32_t vh = quarter ? c.matrixWidth : c.matrixHeight;
+        int32_t vx = int32_t(x) - c.viewX, vy = int32_t(y) - c.viewY;
+        if (vx < 0 || vy < 0 || vx >= vw || vy >= vh)
+            return false;
+        if (c.flipX)
+            vx = vw - 1 - vx;
+        if (c.flipY)
+            vy = vh - 1 - vy;
+        switch (c.rotate)
+        {
+        case 90:
+            mx = c.matrixWidth - 1 - vy;
+            my = vx;
+            break;
+        case 180:
+            mx = c.matrixWidth - 1 - vx;
+            my = c.matrixHeight - 1 - vy;
+            break;
+        case 270:
+            mx = vy;
+            my = c.matrixHeight - 1 - vx;
+            break;
+        default:
+            mx = vx;
+            my = vy;
+        }
+        return true;
+    }
+
+    // Panel coordinates (before the transform) → global LED index
+    static int xyToIndex(const ConfigReader &cfg, uint16_t x, uint16_t y)
+    {
+        if (x >= cfg.matrixWidth || y >= cfg.matrixHeight)
             return -1;
 
         // find which panel this (x,y) lives in and accumulate offset
@@ -99,201 +623,723 @@ public:
     void setPixel(uint16_t x, uint16_t y,
                   uint8_t r, uint8_t g, uint8_t b)
     {
-        int i = xyToIndex(x, y);
-        if (i >= 0)
+        if (x >= cfg.width || y >= cfg.height)
+            return;
+        uint8_t *p = &frame[(size_t(y) * cfg.width + x) * 3];
+        p[0] = r;
+        p[1] = g;
+        p[2] = b;
+    }
+    // Little-endian header fields
+    static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+    static uint32_t le32(const uint8_t *p) { return le16(p) | (uint32_t(le16(p + 2)) << 16); }
+
+    // ——— Scaler: decoders push source rows, framebuffer rows come out ———
+    // Integer source-column/row tables are built once per source size and
+    // reused for every frame of that size.
+    // - nearest: a source row is only needed if some destination row samples
+    //   it (wantRow), and then fills every such destination row.
+    // - area (cfg.scaleMode, downscaling only): every source row is summed
+    //   into a fixed-point accumulator row and each destination pixel is the
+    //   mean of the source block it covers.
+    bool beginImage(int srcW, int srcH)
+    {
+        if (srcW <= 0 || srcH <= 0 || srcH > MAX_SRC_HEIGHT)
         {
-            r = (r * brightness) / 255;
-            g = (g * brightness) / 255;
-            b = (b * brightness) / 255;
-            strip.setPixelColor(i, strip.Color(r, g, b));
+            Serial.printf("❌ Unsupported image size %dx%d\n", srcW, srcH);
+            return false;
         }
+        if (srcW != srcWidth || srcH != srcHeight || dstW != mapW || dstH != mapH)
+            buildScaleMaps(srcW, srcH);
+        memset(target, 0, size_t(dstW) * dstH * 3);
+        accRow = -1;
+        return true;
     }
-    // Read little-endian 32-bit
-    static uint32_t read32(File &f)
+
+    int srcRowFor(int y) const { return rowTab[y]; }
+
+    bool wantRow(int srcY) const { return scaleArea || rowFirst[srcY] >= 0; }
+
+    // rgb: srcWidth RGB888 pixels of source row srcY
+    void pushRow(int srcY, const uint8_t *rgb)
     {
-        uint32_t b0 = f.read();
-        uint32_t b1 = f.read() << 8;
-        uint32_t b2 = f.read() << 16;
-        uint32_t b3 = f.read() << 24;
-        return b0 | b1 | b2 | b3;
+        if (scaleArea)
+        {
+            int y = rowDst[srcY];
+            if (y != accRow)
+            {
+                flushAccRow();
+                accRow = y;
+            }
+            uint32_t *a = acc.data();
+            for (int sx = 0; sx < srcWidth; sx++, rgb += 3)
+            {
+                uint32_t *p = a + colDst[sx] * 3;
+                p[0] += rgb[0];
+                p[1] += rgb[1];
+                p[2] += rgb[2];
+            }
+            return;
+        }
+
+        int y = rowFirst[srcY];
+        if (y < 0)
+            return;
+        size_t stride = size_t(dstW) * 3;
+        uint8_t *first = target + y * stride;
+        uint8_t *dst = first;
+        for (int x = 0; x < dstW; x++, dst += 3)
+            memcpy(dst, rgb + colTab[x] * 3, 3);
+        // further destination rows sampling the same source row (upscaling)
+        for (y++; y < dstH && rowTab[y] == srcY; y++)
+            memcpy(target + y * stride, first, stride);
+    }
+
+    // Finish a decode started with beginImage()
+    void endImage(uint32_t t0)
+    {
+        if (scaleArea)
+            flushAccRow();
+        stats.decoded++;
+        stats.decodeMicros = micros() - t0;
     }
 
-    // Draw a 24-bpp BMP onto the matrix with general nearest-neighbor scaling
-    bool drawBMP(File f)
+    // Draw a BMP onto the matrix with general nearest-neighbor scaling.
+    // Accepts 1/4/8-bpp palettized, 16-bpp (555, or 565/555 via bitfields)
+    // and 24-bpp, uncompressed or BI_RLE8.
+    bool decodeBMP(File f)
     {
+        uint32_t t0 = micros();
         // — Header check —
-        if (f.read() != 'B' || f.read() != 'M')
+        uint8_t h[54 + 12]; // file header + BITMAPINFOHEADER + bitfield masks
+        if (f.read(h, 54) != 54 || h[0] != 'B' || h[1] != 'M')
         {
             Serial.println("❌ Not a BMP");
             f.close();
             return false;
         }
-        f.seek(10);
-        uint32_t dataOffset = read32(f);
-        uint32_t dibSize = read32(f);
+        uint32_t dataOffset = le32(h + 10);
+        uint32_t dibSize = le32(h + 14);
         if (dibSize < 40)
         {
             Serial.println("❌ Unsupported BMP header");
             f.close();
             return false;
         }
-        int32_t bmpW = int32_t(read32(f));
-        int32_t bmpH = int32_t(read32(f));
-        f.seek(2, SeekCur);
-        uint16_t bpp = f.read() | (f.read() << 8);
-        if (bpp != 24)
+        int32_t bmpW = int32_t(le32(h + 18));
+        int32_t bmpH = int32_t(le32(h + 22));
+        uint16_t bpp = le16(h + 28);
+        uint32_t compression = le32(h + 30);
+        uint32_t colorsUsed = le32(h + 46);
+
+        bool supported;
+        switch (compression)
         {
-            Serial.printf("❌ Only 24-bpp BMP (got %u)\n", bpp);
-            f.close();
-            return false;
+        case BI_RGB:
+            supported = bpp == 1 || bpp == 4 || bpp == 8 || bpp == 16 || bpp == 24;
+            break;
+        case BI_RLE8:
+            supported = bpp == 8 && bmpH > 0;
+            break;
+        case BI_BITFIELDS:
+            supported = bpp == 16;
+            break;
+        default:
+            supported = false;
         }
-        if (read32(f) != 0)
+        if (!supported)
         {
-            Serial.println("❌ Compressed BMP not supported");
+            Serial.printf("❌ Unsupported BMP (%u bpp, compression %u)\n", bpp, compression);
             f.close();
             return false;
         }
 
+        // — Color tables —
+        if (bpp <= 8)
+        {
+            uint32_t n = colorsUsed ? std::min<uint32_t>(colorsUsed, 256) : (1u << bpp);
+            memset(palette, 0, sizeof(palette));
+            f.seek(14 + dibSize);
+            for (uint32_t i = 0; i < n; i++)
+            {
+                uint8_t e[4]; // B, G, R, reserved
+                f.read(e, 4);
+                palette[i * 3] = e[2];
+                palette[i * 3 + 1] = e[1];
+                palette[i * 3 + 2] = e[0];
+            }
+        }
+        else if (bpp == 16)
+        {
+            uint32_t masks[3] = {0x7C00, 0x03E0, 0x001F}; // BI_RGB is 555
+            if (compression == BI_BITFIELDS)
+            {
+                f.seek(54);
+                f.read(h + 54, 12);
+                for (int c = 0; c < 3; c++)
+                    masks[c] = le32(h + 54 + c * 4);
+            }
+            buildBitfieldLut(masks);
+        }
+
         // — Prep for scaling —
         int absH = abs(bmpH);
         // rowSize padded to 4-byte boundary:
-        uint32_t rowSize = ((uint32_t(bmpW) * 3 + 3) & ~3);
+        uint32_t rowSize = ((uint32_t(bmpW) * bpp + 31) / 32) * 4;
 
-        // buffer one source row of pixels
-        struct Pixel
+        // buffer one source row of pixels (raw + converted)
+        if (!reserveRow(bmpW))
         {
-            uint8_t r, g, b;
-        };
-        Pixel *rowBuf = (Pixel *)malloc(sizeof(Pixel) * bmpW);
-        if (!rowBuf)
+            f.close();
+            return false;
+        }
+        if (rawBuf.size() < std::max<uint32_t>(rowSize, bmpW))
+            rawBuf.resize(std::max<uint32_t>(rowSize, bmpW));
+        uint8_t *raw = rawBuf.data();
+        uint8_t *row = rowBuf.data();
+
+        if (!beginImage(bmpW, absH))
         {
-            Serial.println("❌ Out of memory");
             f.close();
             return false;
         }
 
-        // clear your matrix
-        strip.clear();
+        if (compression == BI_RLE8)
+        {
+            f.seek(dataOffset);
+            decodeRLE8(f, bmpW, absH);
+            f.close();
+            endImage(t0);
+            return true;
+        }
 
-        // Precompute ratios:
-        float fy = float(absH) / float(cfg.height);
-        float fx = float(bmpW) / float(cfg.width);
+        if (scaleArea)
+        {
+            // every source row contributes: one sequential pass in file order
+            f.seek(dataOffset);
+            for (int bmpRow = 0; bmpRow < absH; bmpRow++)
+            {
+                f.read(raw, rowSize);
+                convertRow(raw, bpp, bmpW, row);
+                // account for BMP’s bottom-up storage if bmpH>0
+                pushRow((bmpH > 0) ? (absH - 1 - bmpRow) : bmpRow, row);
+            }
+            f.close();
+            endImage(t0);
+            return true;
+        }
 
         // For each destination row
-        for (int y = 0; y < cfg.height; y++)
+        int lastRow = -1;
+        for (int y = 0; y < dstH; y++)
         {
-            // map to source row (nearest-neighbor)
-            int srcRow = min(int(y * fy), absH - 1);
+            // map to source row (nearest-neighbor), rows shared by several
+            // destination rows were already pushed
+            int srcRow = srcRowFor(y);
+            if (srcRow == lastRow)
+                continue;
+            lastRow = srcRow;
             // account for BMP’s bottom-up storage if bmpH>0
             int bmpRow = (bmpH > 0) ? (absH - 1 - srcRow) : srcRow;
-            // seek & read that one row
+            // seek & read that one row, convert to RGB
             f.seek(dataOffset + uint32_t(bmpRow) * rowSize);
-            for (int x = 0; x < bmpW; x++)
-            {
-                uint8_t bb = f.read();
-                uint8_t gg = f.read();
-                uint8_t rr = f.read();
-                rowBuf[x] = {rr, gg, bb};
-            }
-
-            // now map each destination X → srcCol, and setPixel
-            for (int x = 0; x < cfg.width; x++)
-            {
-                int srcCol = min(int(x * fx), bmpW - 1);
-                auto &p = rowBuf[srcCol];
-                setPixel(x, y, p.r, p.g, p.b);
-            }
+            f.read(raw, rowSize);
+            convertRow(raw, bpp, bmpW, row);
+            pushRow(srcRow, row);
         }
 
-        free(rowBuf);
         f.close();
-#if DEBUG_MATRIX
-        debugPrintMatrix(*this);
-#endif
-        // strip.setBrightness(brightness); // Ensure current brightness is applied
-        strip.show();
+        endImage(t0);
         return true;
     }
 
-    // Draw a 24-bpp BMP onto the matrix with general nearest-neighbor scaling
-    bool drawBMP(const char *filename)
+    // Decode a PNG line by line through PNGdec straight into the scaler
+    bool decodePNG(File f)
     {
-        File f = SD.open(filename, FILE_READ);
-        if (!f)
+        uint32_t t0 = micros();
+        if (!png)
+            png = new PNG();
+        pngSource() = &f;
+        int rc = png->open("", pngOpen, pngClose, pngRead, pngSeek, pngDraw);
+        if (rc != PNG_SUCCESS)
         {
-            Serial.printf("❌ Open BMP %s failed\n", filename);
+            Serial.printf("❌ PNG open failed (%d)\n", rc);
+            f.close();
             return false;
         }
-        return drawBMP(f);
+        // 16-bit samples are cut to their high byte; a tRNS color key only
+        // comes at 8-bit precision, so those images can't be keyed exactly
+        pngKey = -1;
+        if (png->hasAlpha() && (png->getPixelType() == PNG_PIXEL_TRUECOLOR || png->getPixelType() == PNG_PIXEL_GRAYSCALE))
+        {
+            if (png->getBpp() == 16)
+            {
+                Serial.println("❌ 16-bit PNG with a tRNS color key is not supported");
+                png->close();
+                f.close();
+                return false;
+            }
+            pngKey = png->getTransparentColor();
+        }
+        int w = png->getWidth();
+        if (!reserveRow(w))
+        {
+            png->close();
+            f.close();
+            return false;
+        }
+        if (!beginImage(w, png->getHeight()))
+        {
+            png->close();
+            f.close();
+            return false;
+        }
+        rc = png->decode(this, 0);
+        png->close();
+        f.close();
+        if (rc != PNG_SUCCESS)
+        {
+            Serial.printf("❌ PNG decode failed (%d)\n", rc);
+            return false;
+        }
+        endImage(t0);
+        return true;
     }
 
-    // Call this once you’ve filled the strip (e.g. after drawPNG() or show())
-    void debugPrintMatrix(MatrixDriver &driver)
+    // Pick the decoder by magic bytes (BMP "BM", PNG "\x89PNG")
+    bool decodeImage(File f)
     {
-        auto &strip = driver.strip;
-        auto &cfg = driver.cfg;
-
-        const char *RESET = "\x1b[0m";
-        auto printColor = [&](uint32_t c)
-        {
-            uint8_t r = (c >> 16) & 0xFF;
-            uint8_t g = (c >> 8) & 0xFF;
-            uint8_t b = c & 0xFF;
-            Serial.printf("\x1b[38;2;%u;%u;%um#%06X%s ",
-                          r, g, b, c, RESET);
-        };
+        uint8_t magic[2] = {0, 0};
+        f.read(magic, 2);
+        f.seek(0);
+        if (magic[0] == 0x89 && magic[1] == 'P')
+            return decodePNG(f);
+        return decodeBMP(f);
+    }
 
-        // 1) Original Img Mesh
-        Serial.println(F("=== Original Img Mesh (hex colors) ==="));
-        for (uint16_t y = 0; y < cfg.height; y++)
+    // Files that fit the slurp arena are read with one multi-sector
+    // transfer and decoded from RAM without touching the heap; larger ones
+    // are streamed through a File.
+    bool decodeFile(const char *filename)
+    {
+        uint8_t *buf = (uint8_t *)slurpBuf.data();
+        int32_t n = SDCard.readFile(filename, buf, slurpBuf.size() * 4);
+        if (n < 0)
         {
-            for (uint16_t x = 0; x < cfg.width; x++)
-            {
-                int idx = driver.xyToIndex(x, y);
-                uint32_t c = (idx >= 0)
-                                 ? (strip.getPixelColor(idx) & 0xFFFFFF)
-                                 : 0;
-                printColor(c);
-            }
-            Serial.println();
+            Serial.printf("❌ Open image %s failed\n", filename);
+            return false;
         }
+        if (size_t(n) <= slurpBuf.size() * 4)
+            return decodeImage(memFile.open(buf, n));
 
-        // 2) Remapping Mesh
+        File f = SDCard.open(filename, FILE_READ);
+        return f && decodeImage(f);
+    }
+
+    // Print the LED mapping of the current settings (DEBUG_MATRIX builds
+    // do so after begin() and reconfigure()); the frames themselves go
+    // through the serial mirror.
+    void debugPrintMapping()
+    {
+        // 1) Remapping Mesh
         Serial.println(F("\n=== Remapping Mesh (LED indices) ==="));
         for (uint16_t y = 0; y < cfg.height; y++)
         {
             for (uint16_t x = 0; x < cfg.width; x++)
             {
-                Serial.printf("%3d ", driver.xyToIndex(x, y));
+                Serial.printf("%3d ", xyToIndex(x, y));
             }
             Serial.println();
         }
 
-        // 3) Remapping Sequence
+        // 2) Remapping Sequence
         Serial.println(F("\n=== Remapping Sequence (send order 1→N) ==="));
         for (uint16_t y = 0; y < cfg.height; y++)
         {
             for (uint16_t x = 0; x < cfg.width; x++)
             {
-                int idx = driver.xyToIndex(x, y);
+                int idx = xyToIndex(x, y);
                 Serial.printf("%3u ",
                               (idx >= 0) ? (idx + 1) : 0);
             }
             Serial.println();
         }
 
-        // 4) Origin → Destination Map
+        // 3) Origin → Destination Map
         Serial.println(F("\n=== Origin → Destination Map (origIdx -> sendIdx) ==="));
         // flat, comma-separated
-        for (uint16_t orig = 0; orig < strip.numPixels(); orig++)
+        uint32_t numPixels = ledMap.size();
+        for (uint32_t orig = 0; orig < numPixels; orig++)
         {
-            uint16_t x = orig % cfg.width;
-            uint16_t y = orig / cfg.width;
-            int send = driver.xyToIndex(x, y);
-            Serial.printf("%u->%d", orig, send);
-            if (orig + 1 < strip.numPixels())
+            Serial.printf("%u->%d", unsigned(orig), int(ledMap[orig]));
+            if (orig + 1 < numPixels)
                 Serial.print(", ");
         }
         Serial.println();
     }
+
+#if DEBUG_MATRIX
+    const SerialMirror::Stats &mirrorStats() const { return mirror.stats; }
+#endif
+
+private:
+    SemaphoreHandle_t decodeLock, showLock;
+#if DEBUG_MATRIX
+    SerialMirror mirror;
+#endif
+    uint8_t *target = nullptr; // framebuffer the decoders write into (setTarget())
+    uint16_t dstW = 0, dstH = 0; // its size: the matrix, or an overlay
+
+    enum BmpCompression : uint32_t
+    {
+        BI_RGB = 0,
+        BI_RLE8 = 1,
+        BI_BITFIELDS = 3,
+    };
+
+    uint8_t palette[256 * 3];   // RGB lookup for palettized BMPs
+    uint8_t bitLut[3][256];     // 16-bpp channel value → 8 bit
+    uint8_t bitShift[3], bitWidth[3];
+    uint32_t bitMask[3];
+    std::vector<uint8_t> rawBuf; // one undecoded BMP row
+
+    // Per-channel shift and expansion table for 16-bpp bitfield masks
+    void buildBitfieldLut(const uint32_t masks[3])
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t m = masks[c];
+            bitMask[c] = m;
+            bitShift[c] = m ? __builtin_ctz(m) : 0;
+            bitWidth[c] = std::min(__builtin_popcount(m), 8);
+            uint32_t maxV = (1u << bitWidth[c]) - 1;
+            for (uint32_t v = 0; v <= maxV; v++)
+                bitLut[c][v] = maxV ? v * 255 / maxV : 0;
+            // masks wider than 8 bits keep their top 8 bits
+            bitShift[c] += __builtin_popcount(m) - bitWidth[c];
+        }
+    }
+
+    // Raw BMP row (palettized, 16 or 24 bpp) → RGB888
+    void convertRow(const uint8_t *raw, uint16_t bpp, int w, uint8_t *out)
+    {
+        if (bpp == 24)
+        {
+            for (int x = 0; x < w; x++, raw += 3, out += 3)
+            {
+                out[0] = raw[2];
+                out[1] = raw[1];
+                out[2] = raw[0];
+            }
+            return;
+        }
+        if (bpp == 16)
+        {
+            for (int x = 0; x < w; x++, out += 3)
+            {
+                uint32_t px = le16(raw + x * 2);
+                for (int c = 0; c < 3; c++)
+                    out[c] = bitLut[c][(px & bitMask[c]) >> bitShift[c] & ((1u << bitWidth[c]) - 1)];
+            }
+            return;
+        }
+        uint8_t indexMask = (1 << bpp) - 1;
+        for (int x = 0; x < w; x++, out += 3)
+        {
+            uint32_t bit = uint32_t(x) * bpp;
+            uint8_t i = (raw[bit >> 3] >> (8 - bpp - (bit & 7))) & indexMask;
+            memcpy(out, palette + i * 3, 3);
+        }
+    }
+
+    // BI_RLE8: rows can only be found by decoding sequentially (bottom-up);
+    // rows nobody samples are decoded but not converted
+    void decodeRLE8(File &f, int w, int h)
+    {
+        uint8_t *idx = rawBuf.data();
+        int x = 0, y = 0; // y counts rows from the bottom
+        memset(idx, 0, w);
+        auto nextRow = [&]()
+        {
+            int srcRow = h - 1 - y;
+            if (wantRow(srcRow))
+            {
+                for (int i = 0; i < w; i++)
+                    memcpy(&rowBuf[i * 3], palette + idx[i] * 3, 3);
+                pushRow(srcRow, rowBuf.data());
+            }
+            memset(idx, 0, w);
+            x = 0;
+            y++;
+        };
+        while (y < h)
+        {
+            int n = f.read();
+            int c = f.read();
+            if (c < 0)
+                break;
+            if (n > 0) // encoded run
+            {
+                while (n-- > 0 && x < w)
+                    idx[x++] = c;
+            }
+            else if (c == 0) // end of line
+            {
+                nextRow();
+            }
+            else if (c == 1) // end of bitmap
+            {
+                break;
+            }
+            else if (c == 2) // delta
+            {
+                int dx = f.read();
+                int dy = f.read();
+                for (int keep = x; dy > 0 && y < h; dy--)
+                {
+                    nextRow();
+                    x = keep;
+                }
+                x += dx;
+            }
+            else // absolute run of c indices, padded to 16 bits
+            {
+                for (int i = 0; i < c; i++)
+                {
+                    int v = f.read();
+                    if (x < w)
+                        idx[x++] = v;
+                }
+                if (c & 1)
+                    f.read();
+            }
+        }
+        while (y < h)
+            nextRow();
+    }
+
+    // Longest source row the decoders accept (bounds the row scratch buffer)
+    static const int MAX_SRC_WIDTH = 2048;
+
+    // Image files up to this size are read whole instead of streamed
+    static const size_t MAX_SLURP_BYTES = 32 * 1024;
+    std::vector<uint32_t> slurpBuf; // word-aligned whole-file arena, sized in begin()
+    virtual_file_slot memFile;      // File over slurpBuf
+
+    // Tallest source image (bounds the per-source-row tables)
+    static const int MAX_SRC_HEIGHT = 4096;
+    // Largest source block averaged into one pixel (bounds the reciprocal table)
+    static const uint32_t MAX_AREA_SAMPLES = 1024;
+
+    // — Scale maps, rebuilt only when the source or target size changes —
+    int srcWidth = 0, srcHeight = 0;
+    uint16_t mapW = 0, mapH = 0;
+    bool scaleArea = false;
+    std::vector<uint16_t> colTab, rowTab; // nearest: dst x/y → src col/row
+    std::vector<int16_t> rowFirst;        // nearest: src row → first dst row, -1 if unused
+    std::vector<uint16_t> colDst, rowDst; // area: src col/row → dst x/y
+    std::vector<uint16_t> colCount, rowCount; // area: src cols/rows per dst x/y
+    std::vector<uint32_t> recip;          // area: 65536 / n for block size n
+    std::vector<uint32_t> acc;            // area: RGB sums of the dst row in progress
+    int accRow = -1;
+
+    void buildScaleMaps(int srcW, int srcH)
+    {
+        uint16_t W = dstW, H = dstH;
+        srcWidth = srcW;
+        srcHeight = srcH;
+        mapW = W;
+        mapH = H;
+
+        colTab.resize(W);
+        for (uint32_t x = 0; x < W; x++)
+            colTab[x] = x * srcW / W;
+        rowTab.resize(H);
+        rowFirst.assign(srcH, -1);
+        for (uint32_t y = H; y-- > 0;)
+        {
+            rowTab[y] = y * srcH / H;
+            rowFirst[rowTab[y]] = y;
+        }
+
+        scaleArea = cfg.scaleMode == SCALE_AREA && srcW >= W && srcH >= H;
+        if (!scaleArea)
+            return;
+        colDst.resize(srcW);
+        colCount.assign(W, 0);
+        for (uint32_t sx = 0; sx < uint32_t(srcW); sx++)
+            colCount[colDst[sx] = sx * W / srcW]++;
+        rowDst.resize(srcH);
+        rowCount.assign(H, 0);
+        for (uint32_t sy = 0; sy < uint32_t(srcH); sy++)
+            rowCount[rowDst[sy] = sy * H / srcH]++;
+
+        uint32_t maxN = uint32_t(*std::max_element(colCount.begin(), colCount.end())) *
+                        *std::max_element(rowCount.begin(), rowCount.end());
+        if (maxN > MAX_AREA_SAMPLES)
+        {
+            scaleArea = false;
+            return;
+        }
+        recip.resize(maxN + 1);
+        for (uint32_t n = 1; n <= maxN; n++)
+            recip[n] = (65536 + n / 2) / n;
+        acc.assign(size_t(W) * 3, 0);
+    }
+
+    // Average the accumulated source block sums into framebuffer row accRow
+    void flushAccRow()
+    {
+        if (accRow < 0)
+            return;
+        uint8_t *dst = target + size_t(accRow) * dstW * 3;
+        uint32_t rows = rowCount[accRow];
+        uint32_t *a = acc.data();
+        for (int x = 0; x < dstW; x++, a += 3, dst += 3)
+        {
+            uint32_t r = recip[colCount[x] * rows];
+            dst[0] = (a[0] * r + 0x8000) >> 16;
+            dst[1] = (a[1] * r + 0x8000) >> 16;
+            dst[2] = (a[2] * r + 0x8000) >> 16;
+            a[0] = a[1] = a[2] = 0;
+        }
+    }
+    std::vector<uint8_t> rowBuf; // one RGB888 source row, reused across frames
+    PNG *png = nullptr;          // PNGdec state is large, allocated on first PNG
+    int32_t pngKey = -1;         // tRNS color of the PNG being decoded, -1 if none
+
+    // Size the decode arenas for the matrix up front, so playing images
+    // made for it never grows them: whole-file buffer for an uncompressed
+    // 24-bit BMP of the matrix (capped at MAX_SLURP_BYTES), row buffers for
+    // sources up to twice the matrix width.
+    void reserveScratch()
+    {
+        size_t bmpBytes = 54 + 1024 + size_t(cfg.height) * ((cfg.width * 3 + 3) & ~3);
+        bmpBytes = std::min<size_t>(bmpBytes, size_t(MAX_SLURP_BYTES));
+        if (slurpBuf.size() < (bmpBytes + 3) / 4)
+            slurpBuf.resize((bmpBytes + 3) / 4);
+        size_t w = std::min<size_t>(size_t(cfg.width) * 2, MAX_SRC_WIDTH);
+        if (rowBuf.size() < w * 3)
+            rowBuf.resize(w * 3);
+        if (rawBuf.size() < w * 4)
+            rawBuf.resize(w * 4);
+    }
+
+    bool reserveRow(int w)
+    {
+        if (w <= 0 || w > MAX_SRC_WIDTH)
+        {
+            Serial.printf("❌ Unsupported image width %d\n", w);
+            return false;
+        }
+        if (rowBuf.size() < size_t(w) * 3)
+            rowBuf.resize(size_t(w) * 3);
+        return true;
+    }
+
+    // — PNGdec I/O callbacks, the "file name" is ignored: pngSource() is read —
+    static File *&pngSource()
+    {
+        static File *f = nullptr;
+        return f;
+    }
+    static void *pngOpen(const char *, int32_t *size)
+    {
+        *size = pngSource()->size();
+        return pngSource();
+    }
+    static void pngClose(void *) {}
+    static int32_t pngRead(PNGFILE *pf, uint8_t *buf, int32_t len)
+    {
+        return ((File *)pf->fHandle)->read(buf, len);
+    }
+    static int32_t pngSeek(PNGFILE *pf, int32_t pos)
+    {
+        return ((File *)pf->fHandle)->seek(pos) ? pos : -1;
+    }
+
+    // Convert one decoded PNG line to RGB888 (alpha composited over black,
+    // pixels matching the tRNS color key are black). 16-bit samples are big
+    // endian, their high byte is used.
+    static int pngDraw(PNGDRAW *d)
+    {
+        auto *self = (MatrixDriver *)d->pUser;
+        if (!self->wantRow(d->y))
+            return 1;
+        const uint8_t *s = d->pPixels;
+        uint8_t *o = self->rowBuf.data();
+        int step = d->iBpp == 16 ? 2 : 1; // bytes per sample
+        int32_t key = self->pngKey;
+        for (int x = 0; x < d->iWidth; x++, o += 3)
+        {
+            switch (d->iPixelType)
+            {
+            case PNG_PIXEL_TRUECOLOR:
+            {
+                const uint8_t *p = s + x * 3 * step;
+                o[0] = p[0];
+                o[1] = p[step];
+                o[2] = p[2 * step];
+                if (key >= 0 && int32_t(o[0] << 16 | o[1] << 8 | o[2]) == key)
+                    o[0] = o[1] = o[2] = 0;
+                break;
+            }
+            case PNG_PIXEL_TRUECOLOR_ALPHA:
+            {
+                const uint8_t *p = s + x * 4 * step;
+                uint8_t a = p[3 * step];
+                o[0] = (p[0] * a) / 255;
+                o[1] = (p[step] * a) / 255;
+                o[2] = (p[2 * step] * a) / 255;
+                break;
+            }
+            case PNG_PIXEL_GRAY_ALPHA:
+            {
+                const uint8_t *p = s + x * 2 * step;
+                o[0] = o[1] = o[2] = (p[0] * p[step]) / 255;
+                break;
+            }
+            case PNG_PIXEL_GRAYSCALE:
+                if (step == 2)
+                {
+                    o[0] = o[1] = o[2] = s[x * 2];
+                    break;
+                }
+                // fall through: 1/2/4/8-bit samples
+            case PNG_PIXEL_INDEXED:
+            {
+                // 1/2/4/8-bit samples packed MSB first
+                int bits = d->iBpp;
+                uint32_t bit = uint32_t(x) * bits;
+                uint8_t v = (s[bit >> 3] >> (8 - bits - (bit & 7))) & ((1 << bits) - 1);
+                if (d->iPixelType == PNG_PIXEL_GRAYSCALE)
+                {
+                    o[0] = o[1] = o[2] = key == v ? 0 : v * 255 / ((1 << bits) - 1);
+                }
+                else
+                {
+                    const uint8_t *pal = d->pPalette + v * 3;
+                    uint8_t a = d->iHasAlpha ? d->pPalette[768 + v] : 255;
+                    o[0] = (pal[0] * a) / 255;
+                    o[1] = (pal[1] * a) / 255;
+                    o[2] = (pal[2] * a) / 255;
+                }
+                break;
+            }
+            default:
+                return 0; // unsupported pixel type, abort decode
+            }
+        }
+        self->pushRow(d->y, self->rowBuf.data());
+        return 1;
+    }
+
+    Compositor layers;
+    Rect dirty; // changed since the last transfer
+    int shownScale = -1;
+    uint32_t wireSum = 0; // sum of the color bytes in the output buffer
+    uint16_t limit = 256; // power limiter factor on brightness, / 256
+    uint32_t shownHash = 0;
+    bool shownValid = false;
+    char shownSource[IMAGE_PATH_MAX] = ""; // file currently in the framebuffer, empty if none
 };
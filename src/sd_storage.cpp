@@ -0,0 +1,269 @@
+#include <sd_storage.h>
+#include <FSImpl.h>
+#include <SdFat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <time.h>
+
+static SdFs sd;
+static uint32_t mountedHz = 0;
+
+// SdFat has no locking of its own (the VFS-based SD library had FATFS's
+// FF_FS_REENTRANT), and the card is used by loop(), the prefetch, flash
+// mirror and chain check tasks and the web task at once. Every volume and
+// file operation below holds this lock; recursive, since a File can be
+// released while another call holds it.
+static SemaphoreHandle_t sdLock = xSemaphoreCreateRecursiveMutex();
+
+struct SdGuard
+{
+    SdGuard() { xSemaphoreTakeRecursive(sdLock, portMAX_DELAY); }
+    ~SdGuard() { xSemaphoreGiveRecursive(sdLock); }
+};
+
+class sd_file : public fs::FileImpl {
+private:
+    mutable FsFile _file;
+    String _path;
+public:
+    sd_file(const FsFile &file, const char *path): _file(file), _path(path) {}
+    virtual ~sd_file()
+    {
+        SdGuard g;
+        _file.close();
+    }
+    virtual size_t write(const uint8_t *buf, size_t size) override
+    {
+        SdGuard g;
+        return _file.write(buf, size);
+    }
+    virtual size_t read(uint8_t *buf, size_t size) override
+    {
+        SdGuard g;
+        // whole-sector reads at sector-aligned positions go straight from the
+        // card into buf as one multi-block transfer
+        int n = _file.read(buf, size);
+        return n < 0 ? 0 : n;
+    }
+    virtual void flush() override
+    {
+        SdGuard g;
+        _file.sync();
+    }
+    virtual bool seek(uint32_t pos, SeekMode mode) override
+    {
+        SdGuard g;
+        uint64_t npos = pos;
+        switch (mode)
+        {
+            case SeekSet:
+                break;
+            case SeekCur:
+                npos += _file.curPosition();
+                break;
+            case SeekEnd:
+                npos += _file.fileSize();
+                break;
+        }
+        return _file.seekSet(npos);
+    }
+    virtual size_t position() const override
+    {
+        SdGuard g;
+        return _file.curPosition();
+    }
+    virtual size_t size() const override
+    {
+        SdGuard g;
+        return _file.fileSize();
+    }
+    virtual bool setBufferSize(size_t size) override
+    {
+        return true;
+    }
+    virtual void close() override
+    {
+        SdGuard g;
+        _file.close();
+    }
+    virtual time_t getLastWrite() override {
+        SdGuard g;
+        uint16_t d, t;
+        if (!_file.getModifyDateTime(&d, &t))
+            return 0;
+        struct tm tm = {};
+        tm.tm_year = FAT_YEAR(d) - 1900;
+        tm.tm_mon = FAT_MONTH(d) - 1;
+        tm.tm_mday = FAT_DAY(d);
+        tm.tm_hour = FAT_HOUR(t);
+        tm.tm_min = FAT_MINUTE(t);
+        tm.tm_sec = FAT_SECOND(t);
+        return mktime(&tm);
+    }
+    virtual const char *path() const override
+    {
+        return _path.c_str();
+    }
+    virtual const char *name() const override
+    {
+        int p = _path.lastIndexOf('/');
+        return _path.c_str() + (p < 0 ? 0 : p + 1);
+    }
+    virtual boolean isDirectory(void) override
+    {
+        SdGuard g;
+        return _file.isDir();
+    }
+    virtual fs::FileImplPtr openNextFile(const char *mode) override
+    {
+        SdGuard g;
+        FsFile entry;
+        if (!entry.openNext(&_file, O_RDONLY))
+            return nullptr;
+        return std::make_shared<sd_file>(entry, childPath(entry).c_str());
+    }
+    virtual boolean seekDir(long position) override
+    {
+        SdGuard g;
+        return _file.seekSet(position);
+    }
+    // Full path like the VFS-based SD library
+    virtual String getNextFileName(void) override
+    {
+        SdGuard g;
+        return getNextFileName(nullptr);
+    }
+    virtual String getNextFileName(bool *isDir) override
+    {
+        SdGuard g;
+        FsFile entry;
+        if (!entry.openNext(&_file, O_RDONLY))
+            return "";
+        if (isDir)
+            *isDir = entry.isDir();
+        String p = childPath(entry);
+        entry.close();
+        return p;
+    }
+    virtual void rewindDirectory(void) override
+    {
+        SdGuard g;
+        _file.rewindDirectory();
+    }
+    virtual operator bool() override {
+        SdGuard g;
+        return _file.isOpen();
+    }
+private:
+    String childPath(FsFile &entry)
+    {
+        char nm[256];
+        entry.getName(nm, sizeof(nm));
+        return (_path.endsWith("/") ? _path : _path + "/") + nm;
+    }
+};
+
+class sd_fs : public fs::FSImpl {
+public:
+    virtual fs::FileImplPtr open(const char *path, const char *mode, const bool create) override
+    {
+        SdGuard g;
+        oflag_t flags = O_RDONLY;
+        bool plus = mode[1] == '+';
+        switch (mode[0])
+        {
+            case 'w':
+                flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+                break;
+            case 'a':
+                flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+                break;
+            default:
+                flags = plus ? O_RDWR : O_RDONLY;
+                break;
+        }
+        FsFile f = sd.open(path, flags);
+        if (!f)
+            return nullptr;
+        return std::make_shared<sd_file>(f, path);
+    }
+    virtual bool exists(const char *path) override
+    {
+        SdGuard g;
+        return sd.exists(path);
+    }
+    virtual bool rename(const char *pathFrom, const char *pathTo) override
+    {
+        SdGuard g;
+        return sd.rename(pathFrom, pathTo);
+    }
+    virtual bool remove(const char *path) override
+    {
+        SdGuard g;
+        return sd.remove(path);
+    }
+    virtual bool mkdir(const char *path) override
+    {
+        SdGuard g;
+        return sd.mkdir(path);
+    }
+    virtual bool rmdir(const char *path) override
+    {
+        SdGuard g;
+        return sd.rmdir(path);
+    }
+};
+
+SdFatFS::SdFatFS() : fs::FS(std::make_shared<sd_fs>()) {}
+
+bool SdFatFS::begin(uint8_t cs, SPIClass &spi, uint32_t maxHz)
+{
+    SdGuard g;
+    static const uint32_t steps[] = {SD_SCK_MHZ(25), SD_SCK_MHZ(20), SD_SCK_MHZ(16),
+                                     SD_SCK_MHZ(10), SD_SCK_MHZ(8), SD_SCK_MHZ(4)};
+    mountedHz = 0;
+    for (uint32_t hz : steps)
+    {
+        if (hz > maxHz)
+            continue;
+        // the card is alone on its bus: keep it selected across multi-block reads
+        if (sd.begin(SdSpiConfig(cs, DEDICATED_SPI, hz, &spi)))
+        {
+            mountedHz = hz;
+            return true;
+        }
+        sd.end();
+    }
+    return false;
+}
+
+uint32_t SdFatFS::clockHz() const
+{
+    return mountedHz;
+}
+
+File SdFatFS::openPreallocated(const char *path, uint32_t size)
+{
+    SdGuard g;
+    FsFile f = sd.open(path, O_RDWR | O_CREAT | O_TRUNC);
+    if (!f)
+        return File();
+    if (size && !f.preAllocate(size))
+        Serial.printf("⚠️ No contiguous space for %s, file will be fragmented\n", path);
+    return File(std::make_shared<sd_file>(f, path));
+}
+
+int32_t SdFatFS::readFile(const char *path, uint8_t *buf, size_t cap)
+{
+    SdGuard g;
+    FsFile f = sd.open(path, O_RDONLY);
+    if (!f)
+        return -1;
+    int32_t n = f.fileSize();
+    if (size_t(n) <= cap && f.read(buf, n) != n)
+        n = -1;
+    f.close();
+    return n;
+}
+
+SdFatFS SDCard;
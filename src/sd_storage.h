@@ -0,0 +1,29 @@
+#pragma once
+#include <FS.h>
+#include <SPI.h>
+
+// fs::FS over SdFat, so the rest of the firmware (and AsyncWebServer's
+// file responses) keep using File while the card runs on SdFat's
+// dedicated-SPI, multi-sector driver. Every call is serialized by one lock,
+// so the tasks that share the card can use it at the same time.
+class SdFatFS : public fs::FS
+{
+public:
+    SdFatFS();
+
+    // Mount the card, trying maxHz first and stepping down until init works
+    bool begin(uint8_t cs, SPIClass &spi, uint32_t maxHz);
+    // SPI clock the card was mounted with, 0 if not mounted
+    uint32_t clockHz() const;
+
+    // Create (or truncate) path with `size` bytes allocated as one contiguous
+    // cluster run, so sequential reads never walk the FAT
+    File openPreallocated(const char *path, uint32_t size);
+
+    // Read a whole file into buf without creating a File (no heap use).
+    // Returns the file size (buf is only filled if it is <= cap), -1 if the
+    // file can't be opened or read.
+    int32_t readFile(const char *path, uint8_t *buf, size_t cap);
+};
+
+extern SdFatFS SDCard;
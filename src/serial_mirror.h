@@ -0,0 +1,114 @@
+// serial_mirror.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <vector>
+#include "config.h"
+
+#ifndef DEBUG_MATRIX_MS
+#define DEBUG_MATRIX_MS 1000 // shortest gap between two mirrored frames
+#endif
+#ifndef DEBUG_MATRIX_BINARY
+#define DEBUG_MATRIX_BINARY 0 // 1: raw frames instead of hex text
+#endif
+
+// ——— Copy of the shown frames on the serial port (DEBUG_MATRIX builds) ———
+// offer() runs on the showing task and only copies the frame when the
+// previous one is printed and DEBUG_MATRIX_MS have passed; printing happens
+// in an idle-priority task, so a slow serial port delays the mirror, never
+// the LEDs. A frame equal to the last printed one is not printed again.
+//   text:   "FB <seq> <w>x<h>", then one line of RRGGBB per row
+//   binary: "LMFB", u16 w, u16 h (little endian), w * h * 3 bytes RGB
+class SerialMirror
+{
+public:
+    struct Stats
+    {
+        uint32_t printed = 0;
+        uint32_t skipped = 0; // offered too soon / while printing, or unchanged
+    } stats;
+
+    void begin()
+    {
+        if (!task)
+            xTaskCreate(taskEntry, "fbmirror", 4096, this, tskIDLE_PRIORITY, &task);
+    }
+
+    // A frame was just shown
+    void offer(const uint8_t *fb, uint16_t w, uint16_t h)
+    {
+        uint32_t now = millis();
+        if (!task || busy || now - lastMillis < DEBUG_MATRIX_MS)
+        {
+            stats.skipped++;
+            return;
+        }
+        buf.assign(fb, fb + size_t(w) * h * 3);
+        width = w;
+        height = h;
+        lastMillis = now;
+        busy = true;
+        xTaskNotifyGive(task);
+    }
+
+private:
+    TaskHandle_t task = nullptr;
+    std::vector<uint8_t> buf; // frame being printed, owned by the task while busy
+    uint16_t width = 0, height = 0;
+    uint32_t lastMillis = 0, lastHash = 0, seq = 0;
+    volatile bool busy = false;
+
+    static void taskEntry(void *arg) { static_cast<SerialMirror *>(arg)->run(); }
+
+    void run()
+    {
+        for (;;)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            print();
+            busy = false;
+        }
+    }
+
+    void print()
+    {
+        uint32_t h = fnv1a(buf.data(), buf.size());
+        if (h == lastHash)
+        {
+            stats.skipped++;
+            return;
+        }
+        lastHash = h;
+        seq++;
+#if DEBUG_MATRIX_BINARY
+        uint8_t head[8] = {'L', 'M', 'F', 'B', uint8_t(width), uint8_t(width >> 8), uint8_t(height), uint8_t(height >> 8)};
+        Serial.write(head, sizeof(head));
+        Serial.write(buf.data(), buf.size());
+#else
+        static const char HEX_DIGITS[] = "0123456789ABCDEF";
+        Serial.printf("FB %lu %ux%u\n", (unsigned long)seq, width, height);
+        char line[64 * 6 + 1]; // up to 64 pixels per write
+        const uint8_t *p = buf.data();
+        for (uint16_t y = 0; y < height; y++)
+        {
+            for (uint16_t x = 0; x < width;)
+            {
+                size_t n = 0;
+                for (; x < width && n < sizeof(line) - 1; x++, p += 3)
+                {
+                    for (int c = 0; c < 3; c++)
+                    {
+                        line[n++] = HEX_DIGITS[p[c] >> 4];
+                        line[n++] = HEX_DIGITS[p[c] & 15];
+                    }
+                }
+                Serial.write((const uint8_t *)line, n);
+            }
+            Serial.write('\n');
+        }
+#endif
+        stats.printed++;
+    }
+};
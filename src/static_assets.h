@@ -0,0 +1,110 @@
+// static_assets.h
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <vector>
+#include "config.h"
+
+// ——— Web UI files held in RAM ———
+// Loaded once at boot, so page loads (and captive-portal redirects) never
+// touch the SD card. A pre-gzipped "<file>.gz" next to the file is preferred
+// and served as is with Content-Encoding: gzip to clients that accept it;
+// the rare one that doesn't gets the plain file streamed from SD. Responses
+// from RAM carry an ETag; a matching If-None-Match gets an empty 304.
+class StaticAssets
+{
+public:
+    // Read `path` (or `path`.gz) from SD; false if neither exists
+    bool load(const char *path, const char *type)
+    {
+        Asset a;
+        a.path = path;
+        a.type = type;
+        String gzPath = a.path + ".gz";
+        a.gzip = SDCard.exists(gzPath);
+        a.plain = SDCard.exists(a.path);
+        File f = SDCard.open(a.gzip ? gzPath : a.path, FILE_READ);
+        if (!f)
+        {
+            Serial.printf("⚠️ Missing %s\n", path);
+            return false;
+        }
+        a.body.resize(f.size());
+        bool ok = f.read(a.body.data(), a.body.size()) == a.body.size();
+        f.close();
+        if (!ok)
+            return false;
+
+        char etag[12];
+        snprintf(etag, sizeof(etag), "\"%08x\"", unsigned(fnv1a(a.body.data(), a.body.size())));
+        a.etag = etag;
+        Serial.printf("Cached %s%s (%u bytes)\n", path, a.gzip ? ".gz" : "", unsigned(a.body.size()));
+        assets.push_back(std::move(a));
+        return true;
+    }
+
+    // Answer the request from the cache; false if `path` was never loaded
+    bool serve(AsyncWebServerRequest *req, const String &path)
+    {
+        const Asset *a = find(path);
+        if (!a)
+            return false;
+
+        if (a->gzip && !acceptsGzip(req))
+        {
+            if (!a->plain)
+            {
+                req->send(406, "text/plain", "gzip only");
+                return true;
+            }
+            AsyncWebServerResponse *res = req->beginResponse(SDCard, a->path, a->type);
+            res->addHeader("Vary", "Accept-Encoding");
+            res->addHeader("Cache-Control", "no-cache");
+            req->send(res);
+            return true;
+        }
+
+        AsyncWebServerResponse *res;
+        if (req->hasHeader("If-None-Match") && req->header("If-None-Match") == a->etag)
+        {
+            res = req->beginResponse(304);
+        }
+        else
+        {
+            res = req->beginResponse(200, a->type, a->body.data(), a->body.size());
+            if (a->gzip)
+                res->addHeader("Content-Encoding", "gzip");
+        }
+        res->addHeader("ETag", a->etag);
+        if (a->gzip)
+            res->addHeader("Vary", "Accept-Encoding");
+        // revalidate on every use, that costs one 304 from RAM
+        res->addHeader("Cache-Control", "no-cache");
+        req->send(res);
+        return true;
+    }
+
+private:
+    struct Asset
+    {
+        String path, type, etag;
+        std::vector<uint8_t> body; // never changes after load(), responses point into it
+        bool gzip = false;  // body is the .gz
+        bool plain = false; // the uncompressed file is on SD too
+    };
+    std::vector<Asset> assets;
+
+    static bool acceptsGzip(AsyncWebServerRequest *req)
+    {
+        return req->hasHeader("Accept-Encoding") && req->header("Accept-Encoding").indexOf("gzip") >= 0;
+    }
+
+    const Asset *find(const String &path) const
+    {
+        for (auto &a : assets)
+            if (a.path == path)
+                return &a;
+        return nullptr;
+    }
+};
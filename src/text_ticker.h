@@ -0,0 +1,254 @@
+// text_ticker.h
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <vector>
+#include "font5x7.h"
+#include "matrix_driver.h"
+
+// ——— Text rendered on the device, static or scrolling ———
+// set() lays a string out once: every distinct character is rasterized at
+// the chosen scale into the glyph atlas (one coverage byte per pixel,
+// column-major, spacing column included) and the text becomes a list of
+// atlas slots, so rendering a frame only copies atlas columns. The scroll
+// position is kept in 1/256 pixels and derived from the clock, so the
+// speed doesn't depend on the frame rate; in-between positions blend two
+// neighbouring columns.
+class TextTicker
+{
+public:
+    static const size_t MAX_TEXT = 256;        // characters
+    static const size_t MAX_ATLAS = 24 * 1024; // glyph atlas bytes
+    static const uint8_t MAX_SCALE = 4;
+
+    struct Style
+    {
+        uint8_t fg[3] = {255, 255, 255};
+        uint8_t bg[3] = {0, 0, 0};
+        uint8_t scale = 0;   // font pixel size, 0 = largest that fits the height
+        uint16_t speed = 20; // pixels per second, 0 = static (centered if it fits)
+        int16_t y = -1;      // top row, -1 = centered
+    };
+
+    struct Stats
+    {
+        uint32_t frames = 0;
+        uint32_t renderMicros = 0; // last frame
+        uint16_t glyphs = 0;       // distinct glyphs in the atlas
+        uint32_t atlasBytes = 0;
+    } stats;
+
+    TextTicker() : lock(xSemaphoreCreateMutex()) {}
+
+    // Lay out `text` for a w x h matrix. False if it is empty or its glyphs
+    // don't fit the atlas, the current text stays then. A running ticker
+    // shows the new text right away, a stopped one from start() on.
+    bool set(const char *text, const Style &s, uint16_t w, uint16_t h)
+    {
+        std::vector<uint8_t> next;
+        for (const char *p = text; *p && next.size() < MAX_TEXT; p++)
+        {
+            uint8_t c = *p;
+            if ((c & 0xC0) == 0x80)
+                continue; // UTF-8 continuation byte, the lead byte became '?'
+            next.push_back(c >= FONT5X7_FIRST && c <= FONT5X7_LAST ? c : '?');
+        }
+        size_t bytes = atlasBytes(next, s, h);
+        if (next.empty() || bytes > MAX_ATLAS)
+        {
+            if (bytes > MAX_ATLAS)
+                Serial.printf("⚠️ Text needs %u atlas bytes, max %u\n", unsigned(bytes), unsigned(MAX_ATLAS));
+            return false;
+        }
+        LockGuard g(lock);
+        chars.swap(next);
+        style = s;
+        ready = layout(w, h);
+        running = running && ready;
+        return ready;
+    }
+
+    // Show the text laid out by set()
+    void start()
+    {
+        LockGuard g(lock);
+        if (!ready)
+            return;
+        started = millis();
+        drawn = false;
+        running = true;
+    }
+
+    // Matrix size changed: lay the current text out again
+    void resize(uint16_t w, uint16_t h)
+    {
+        LockGuard g(lock);
+        if (ready)
+            ready = layout(w, h);
+        running = running && ready;
+    }
+
+    void stop()
+    {
+        LockGuard g(lock);
+        running = false;
+    }
+
+    bool active() const { return running; }
+
+    // Render the frame for `now` (millis) and show it. False if nothing
+    // moved since the last one (static text).
+    bool show(MatrixDriver &drv, uint32_t now)
+    {
+        LockGuard g(lock);
+        if (!running || (drawn && !scrolling))
+            return false;
+        uint32_t t0 = micros();
+        int32_t pos; // text column at screen x = 0, in 1/256 px
+        if (scrolling)
+        {
+            // enter on the right, leave on the left, then start over
+            uint64_t span = uint64_t(textW + width) << 8;
+            pos = int32_t((uint64_t(now - started) * style.speed * 256 / 1000) % span) - (int32_t(width) << 8);
+        }
+        else
+        {
+            pos = -((int32_t(width) - textW) / 2) * 256;
+        }
+        renderAt(pos);
+        drawn = true;
+        stats.frames++;
+        stats.renderMicros = micros() - t0;
+        return drv.showFrame(fb.data(), fb.size());
+    }
+
+private:
+    SemaphoreHandle_t lock;
+    Style style;
+    std::vector<uint8_t> chars; // printable ASCII
+    std::vector<uint8_t> atlas; // slot-major: adv columns of glyphH coverage bytes
+    std::vector<uint8_t> slots; // atlas slot per character
+    std::vector<uint8_t> fb;    // width x height RGB888
+    uint16_t width = 0, height = 0;
+    uint8_t scale = 1;
+    uint16_t adv = 0, glyphH = 0; // atlas columns per character, rows per column
+    int16_t top = 0;              // first text row on the matrix
+    int32_t textW = 0;            // columns of the whole text
+    uint32_t started = 0;
+    volatile bool running = false;
+    bool ready = false; // laid out, start() can show it
+    bool scrolling = false, drawn = false;
+
+    // Font pixel size for style s on a matrix h rows high
+    static uint8_t fontScale(const Style &s, uint16_t h)
+    {
+        return s.scale ? std::min<uint8_t>(s.scale, uint8_t(MAX_SCALE))
+                       : std::max(1, std::min<int>(h / FONT5X7_H, MAX_SCALE));
+    }
+
+    // Glyph atlas size for `text` in style s: one slot per distinct character
+    static size_t atlasBytes(const std::vector<uint8_t> &text, const Style &s, uint16_t h)
+    {
+        bool seen[FONT5X7_LAST - FONT5X7_FIRST + 1] = {};
+        size_t n = 0;
+        for (uint8_t c : text)
+            if (!seen[c - FONT5X7_FIRST])
+            {
+                seen[c - FONT5X7_FIRST] = true;
+                n++;
+            }
+        uint8_t sc = fontScale(s, h);
+        return n * (FONT5X7_W + 1) * sc * FONT5X7_H * sc;
+    }
+
+    bool layout(uint16_t w, uint16_t h)
+    {
+        width = w;
+        height = h;
+        if (chars.empty() || !w || !h)
+            return false;
+        scale = fontScale(style, h);
+        adv = (FONT5X7_W + 1) * scale;
+        glyphH = FONT5X7_H * scale;
+        top = style.y >= 0 ? style.y : (int(h) - glyphH) / 2;
+        textW = int32_t(chars.size()) * adv - scale; // no spacing after the last one
+
+        // one atlas slot per distinct character
+        const uint8_t GLYPHS = FONT5X7_LAST - FONT5X7_FIRST + 1;
+        int16_t slotOf[GLYPHS];
+        uint8_t glyphOf[GLYPHS];
+        memset(slotOf, -1, sizeof(slotOf));
+        uint16_t n = 0;
+        slots.resize(chars.size());
+        for (size_t i = 0; i < chars.size(); i++)
+        {
+            uint8_t c = chars[i] - FONT5X7_FIRST;
+            if (slotOf[c] < 0)
+            {
+                glyphOf[n] = c;
+                slotOf[c] = n++;
+            }
+            slots[i] = slotOf[c];
+        }
+        size_t glyphBytes = size_t(adv) * glyphH;
+        if (n * glyphBytes > MAX_ATLAS)
+        {
+            Serial.printf("⚠️ Text needs %u atlas bytes, max %u\n", unsigned(n * glyphBytes), unsigned(MAX_ATLAS));
+            return false;
+        }
+        atlas.assign(n * glyphBytes, 0);
+        for (uint16_t slot = 0; slot < n; slot++)
+        {
+            uint8_t *g = &atlas[slot * glyphBytes];
+            for (uint16_t col = 0; col < FONT5X7_W * scale; col++)
+            {
+                uint8_t bits = FONT5X7[glyphOf[slot]][col / scale];
+                for (uint16_t row = 0; row < glyphH; row++)
+                    g[col * glyphH + row] = (bits >> (row / scale)) & 1 ? 255 : 0;
+            }
+        }
+        stats.glyphs = n;
+        stats.atlasBytes = atlas.size();
+
+        fb.resize(size_t(w) * h * 3);
+        for (size_t i = 0; i < fb.size(); i += 3)
+            memcpy(&fb[i], style.bg, 3);
+        scrolling = style.speed != 0;
+        started = millis();
+        drawn = false;
+        return true;
+    }
+
+    // Coverage column `tc` of the laid-out text, nullptr outside it
+    const uint8_t *column(int32_t tc) const
+    {
+        if (tc < 0 || tc >= textW)
+            return nullptr;
+        return &atlas[(size_t(slots[tc / adv]) * adv + tc % adv) * glyphH];
+    }
+
+    // Draw the text band with text column pos / 256 at screen column 0
+    void renderAt(int32_t pos)
+    {
+        uint16_t frac = pos & 0xFF, inv = 256 - frac;
+        int32_t tc = pos >> 8; // floor, also for negative positions
+        int r0 = std::max(0, -int(top)), r1 = std::min<int>(glyphH, int(height) - top);
+        if (r0 >= r1)
+            return; // band is off the matrix
+        for (uint16_t x = 0; x < width; x++, tc++)
+        {
+            const uint8_t *c0 = column(tc), *c1 = column(tc + 1);
+            uint8_t *p = &fb[(size_t(top + r0) * width + x) * 3];
+            for (int r = r0; r < r1; r++, p += size_t(width) * 3)
+            {
+                uint16_t cov = ((c0 ? c0[r] : 0) * inv + (c1 ? c1[r] : 0) * frac) >> 8;
+                uint16_t a = cov + (cov >> 7), ia = 256 - a; // 0..256
+                p[0] = (style.fg[0] * a + style.bg[0] * ia) >> 8;
+                p[1] = (style.fg[1] * a + style.bg[1] * ia) >> 8;
+                p[2] = (style.fg[2] * a + style.bg[2] * ia) >> 8;
+            }
+        }
+    }
+};
@@ -0,0 +1,134 @@
+// upload_pool.h
+#pragma once
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <vector>
+
+// ——— Request bodies of concurrent uploads ———
+// Each POST that needs its whole body gets one of a fixed number of slots,
+// owned by its AsyncWebServerRequest until the handler is done or the client
+// disconnects, so parallel uploads never share a buffer. Slot buffers are
+// preallocated; bodies that don't fit grow the buffer for that one request.
+// All callbacks run on the AsyncTCP task, so no locking is needed.
+class UploadPool
+{
+public:
+    static const size_t PREALLOC_BYTES = 8 * 1024; // a frame-sized BMP fits
+    static const size_t HEAP_RESERVE = 16 * 1024;  // left free for everything else
+
+    struct Stats
+    {
+        uint32_t accepted = 0;
+        uint32_t busy = 0;     // answered 503, all slots taken or out of heap
+        uint32_t tooLarge = 0; // answered 413
+    } stats;
+
+    UploadPool(uint8_t maxUploads) { resize(maxUploads); }
+
+    // http.maxUploads changed: new slots are added now, slots still owned by
+    // a request are dropped when it releases them. Slot buffers move along
+    // with their vector, bodies being handled stay where they are.
+    void resize(uint8_t maxUploads)
+    {
+        limit = maxUploads;
+        while (slots.size() < limit)
+        {
+            slots.emplace_back();
+            slots.back().buf.reserve(PREALLOC_BYTES);
+        }
+        trim();
+    }
+
+    // Feed one body chunk of `req`. Returns the complete body after the last
+    // chunk, else nullptr. Answers 413 (total > limit) or 503 (no free slot)
+    // itself on the first chunk; later chunks of a rejected request are
+    // dropped. Call release(req) once the body has been handled.
+    std::vector<uint8_t> *collect(AsyncWebServerRequest *req, uint8_t *data, size_t len,
+                                  size_t index, size_t total, size_t limit)
+    {
+        Slot *s = index == 0 ? acquire(req, total, limit) : find(req);
+        if (!s)
+            return nullptr;
+        if (index + len > total)
+            len = total - index;
+        memcpy(s->buf.data() + index, data, len);
+        return index + len == total ? &s->buf : nullptr;
+    }
+
+    void release(AsyncWebServerRequest *req)
+    {
+        Slot *s = find(req);
+        if (!s)
+            return;
+        s->owner = nullptr;
+        // give back what an oversized body took
+        if (s->buf.capacity() > PREALLOC_BYTES)
+        {
+            std::vector<uint8_t>().swap(s->buf);
+            s->buf.reserve(PREALLOC_BYTES);
+        }
+        s->buf.clear();
+        trim();
+    }
+
+    uint8_t capacity() const { return limit; }
+    uint8_t active() const
+    {
+        uint8_t n = 0;
+        for (auto &s : slots)
+            n += s.owner != nullptr;
+        return n;
+    }
+
+private:
+    struct Slot
+    {
+        AsyncWebServerRequest *owner = nullptr;
+        std::vector<uint8_t> buf;
+    };
+    std::vector<Slot> slots;
+    uint8_t limit = 0; // http.maxUploads, slots.size() stays above while owned ones wait
+
+    // Drop free slots above the limit
+    void trim()
+    {
+        for (auto it = slots.begin(); slots.size() > limit && it != slots.end();)
+            it = it->owner ? it + 1 : slots.erase(it);
+    }
+
+    Slot *find(AsyncWebServerRequest *req)
+    {
+        for (auto &s : slots)
+            if (s.owner == req)
+                return &s;
+        return nullptr;
+    }
+
+    Slot *acquire(AsyncWebServerRequest *req, size_t total, size_t limit)
+    {
+        if (total > limit)
+        {
+            stats.tooLarge++;
+            req->send(413, "application/json", "{\"error\":\"body too large\"}");
+            return nullptr;
+        }
+        Slot *s = find(nullptr);
+        if (s && total > s->buf.capacity() && ESP.getMaxAllocHeap() < total + HEAP_RESERVE)
+            s = nullptr;
+        if (!s)
+        {
+            stats.busy++;
+            AsyncWebServerResponse *res = req->beginResponse(503, "application/json", "{\"error\":\"busy\"}");
+            res->addHeader("Retry-After", "1");
+            req->send(res);
+            return nullptr;
+        }
+        s->owner = req;
+        s->buf.resize(total);
+        req->onDisconnect([this, req]()
+                          { release(req); });
+        stats.accepted++;
+        return s;
+    }
+};
@@ -9,6 +9,12 @@ private:
     size_t _pos;
 public:
     virtual_file(uint8_t *buf, size_t len): _buf(buf), _len(len), _pos(0) {}
+    void reset(uint8_t *buf, size_t len)
+    {
+        _buf = buf;
+        _len = len;
+        _pos = 0;
+    }
     virtual size_t write(const uint8_t *buf, size_t size) override
     {
         return 0;
@@ -100,3 +106,12 @@ File make_virtual_file(uint8_t *buf, size_t len)
 {
     return File(std::make_shared<virtual_file>(buf, len));
 }
+
+File virtual_file_slot::open(uint8_t *buf, size_t len)
+{
+    if (!_impl)
+        _impl = std::make_shared<virtual_file>(buf, len);
+    else
+        static_cast<virtual_file &>(*_impl).reset(buf, len);
+    return File(_impl);
+}
@@ -1,3 +1,13 @@
+#pragma once
 #include <FS.h>
 
 File make_virtual_file(uint8_t *buf, size_t len);
+
+// Like make_virtual_file(), but every open() reuses the same impl, so only
+// the first call allocates. One file per slot at a time.
+class virtual_file_slot {
+private:
+    fs::FileImplPtr _impl;
+public:
+    File open(uint8_t *buf, size_t len);
+};